@@ -0,0 +1,38 @@
+#ifndef _GMR_H_
+#define _GMR_H_
+
+/*==================[inclusions]=============================================*/
+
+#include "../parser.h"
+
+/*==================[macros]=================================================*/
+
+#undef PARSER_DATA_T
+#undef PARSER_RESULTS_T
+
+#define PARSER_DATA_T                       PARSER_DATA_TYPE(gmr)
+#define PARSER_RESULTS_T                    PARSER_RESULTS_TYPE(gmr)
+#define PARSER_RESULTS_GMR_T                PARSER_RESULTS_TYPE(gmr)
+
+#define INITIALIZER_AT_GMR {AT_MSG_GMR, STATUS_UNINITIALIZED, 0, 0, &FUNCTIONS_AT_GMR}
+
+/*==================[typedef]================================================*/
+
+typedef struct {
+    fsmStatus       state;
+    uint8_t         readPos;
+} PARSER_DATA_T;
+
+/** \brief Versión del firmware AT, por ejemplo "AT version:1.2.0.0" resulta en 1 y 2. */
+typedef struct {
+    uint8_t major;
+    uint8_t minor;
+} PARSER_RESULTS_T;
+
+/*==================[external data declaration]==============================*/
+
+extern const ParserFunctions FUNCTIONS_AT_GMR;
+
+/*==================[external functions declaration]=========================*/
+
+#endif // _GMR_H_
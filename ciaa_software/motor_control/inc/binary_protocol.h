@@ -0,0 +1,169 @@
+#ifndef __BINARY_PROTOCOL_H_
+#define __BINARY_PROTOCOL_H_
+
+ /** \addtogroup MotorControl
+ ** @{ */
+
+/** \brief Protocolo binario con tramas delimitadas por longitud y CRC.
+ *
+ * Alternativa a los comandos ASCII ("$...$"), que una conexión puede habilitar
+ * enviando "$BINARIO=1$". Cada trama tiene el formato:
+ *
+ \verbatim
+  +------+------+----------+-----------------+-----------+
+  | SYNC | TIPO | LONGITUD | DATOS           | CRC16     |
+  | 0xA5 | 1 B  | 1 B      | LONGITUD bytes  | 2 B (LE)  |
+  +------+------+----------+-----------------+-----------+
+ \endverbatim
+ *
+ * Los campos de más de un byte dentro de DATOS son little-endian. El CRC es
+ * CRC-16/CCITT (polinomio 0x1021, valor inicial 0xFFFF) calculado sobre TIPO,
+ * LONGITUD y DATOS.
+ *
+ * La decodificación se guía por el campo LONGITUD: si la trama completa está
+ * en los datos recibidos se valida y se entrega sin copiarla; sólo una trama
+ * que quedó partida entre dos mensajes se acumula en el buffer del decodificador.
+ *
+ */
+
+ /** \defgroup BinaryProtocol Binary Protocol
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+
+#include "ciaaPOSIX_stdio.h"  /* <= device handler header */
+
+/*==================[macros]=================================================*/
+
+/** \brief Byte de sincronismo con el que comienza cada trama. */
+#define BINPROTO_SYNC				(0xA5)
+
+/** \brief Cantidad de bytes de la trama que no son datos: sincronismo, tipo, longitud y CRC. */
+#define BINPROTO_OVERHEAD			(5)
+
+/** \brief Máxima cantidad de bytes de datos de una trama. */
+#define BINPROTO_MAX_PAYLOAD		(64)
+
+/** \brief Máxima longitud de una trama completa. */
+#define BINPROTO_MAX_FRAME_LENGTH	(BINPROTO_MAX_PAYLOAD + BINPROTO_OVERHEAD)
+
+/** \brief Escribe un entero de 16 bits en formato little-endian. */
+#define binproto_putU16(buf, value)	do { (buf)[0] = (uint8_t)(value); (buf)[1] = (uint8_t)((value) >> 8); } while (0)
+
+/** \brief Escribe un entero de 32 bits en formato little-endian. */
+#define binproto_putU32(buf, value)	do { binproto_putU16(buf, value); binproto_putU16(&(buf)[2], (value) >> 16); } while (0)
+
+/** \brief Lee un entero de 16 bits en formato little-endian. */
+#define binproto_getU16(buf)		((uint16_t)((buf)[0] | ((uint16_t)(buf)[1] << 8)))
+
+/*==================[typedef]================================================*/
+
+/** \brief Tipos de trama. Los tipos con el bit 7 en 1 son enviados por la placa. */
+typedef enum {
+    BINPROTO_MSG_DUTYCYCLE              = 0x01, /**< Motor (u8), ciclo de trabajo (i8, -100 a 100). */
+    BINPROTO_MSG_CARACTERIZAR           = 0x02, /**< Motor (u8), tiempo en ms (u16). */
+    BINPROTO_MSG_CANCELAR_CARACTERIZAR  = 0x03, /**< Sin datos. */
+    BINPROTO_MSG_SUSCRIBIR              = 0x04, /**< Streams (u8), períodos entre envíos (u8). */
+    BINPROTO_MSG_MODO                   = 0x05, /**< Protocolo de la conexión (u8): 0 ASCII, 1 binario. También es la respuesta al cambio. */
+    BINPROTO_MSG_MOTORES                = 0x06, /**< Ciclo de trabajo de cada motor (i8 c/u, -100 a 100), aplicados a la vez. */
+    BINPROTO_MSG_DIFERENCIAL            = 0x07, /**< Velocidad lineal en mm/s (i16) y angular en milirradianes/s (i16). \see drive.h */
+    BINPROTO_MSG_PING                   = 0x08, /**< Sin datos. Mantiene viva la conexión de quien controla los motores, \see deadman.h */
+
+    BINPROTO_MSG_SPEED                  = 0x81, /**< Tipo de dato (u8, \see SpeedType) y velocidad de cada encoder: u16 c/u, o i16 para SPEED_TYPE_EDGE_TIMED y SPEED_TYPE_OBSERVED. */
+    BINPROTO_MSG_DATOS_CARACTERIZAR     = 0x82, /**< Motor (u8), ciclo de trabajo (u8), cantidad de interrupciones (u16). */
+    BINPROTO_MSG_FIN_CARACTERIZAR       = 0x83, /**< Sin datos. */
+    BINPROTO_MSG_ERROR                  = 0x84, /**< Tipo de trama que causó el error (u8). */
+    BINPROTO_MSG_TRAZA                  = 0x85, /**< Encoder (u8), desbordes (u32) y ciclos entre flancos (u32 c/u). \see trace.h */
+    BINPROTO_MSG_POSE                   = 0x86, /**< x en mm (i32), y en mm (i32) y orientación en milirradianes (u16). \see odometry.h */
+    BINPROTO_MSG_ATASCO                 = 0x87  /**< Motor cortado por atascado (u8). \see stall.h */
+} BinprotoMessageType;
+
+
+/** \brief Trama recibida y validada. */
+typedef struct {
+    uint8_t         type; /**< \see BinprotoMessageType */
+    uint8_t         length; /**< Cantidad de bytes de datos. */
+    const uint8_t * payload; /**< Datos de la trama, sólo válidos durante la llamada al handler. */
+} BinprotoFrame;
+
+
+/** \brief Tipo de función llamada por el decodificador por cada trama válida.
+ *
+ * \param[in] frame Trama recibida.
+ * \param[in] connectionID Conexión por la que se recibió.
+ *
+ */
+typedef void (*binprotoFrameHandler_type)(const BinprotoFrame * frame, uint8_t connectionID);
+
+
+/** \brief Estado del decodificador de una conexión. */
+typedef struct {
+    uint8_t     buffer[BINPROTO_MAX_FRAME_LENGTH]; /**< Trama parcial, partida entre dos mensajes. */
+    uint8_t     count; /**< Cantidad de bytes en \p buffer. */
+    uint32_t    crcErrors; /**< Tramas descartadas por CRC inválido. */
+} BinprotoDecoder;
+
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+
+/** \brief Inicializa (o reinicia) un decodificador, descartando cualquier trama parcial. */
+extern void binproto_initDecoder(BinprotoDecoder * decoder);
+
+
+/** \brief Decodifica los datos recibidos por una conexión.
+ *
+ * Llama a \p handler por cada trama completa con CRC válido. Los bytes que no
+ * forman parte de una trama se descartan hasta el próximo byte de sincronismo.
+ *
+ * \param[inout] decoder Decodificador de la conexión.
+ * \param[in] data Datos recibidos.
+ * \param[in] length Cantidad de bytes recibidos.
+ * \param[in] handler Función a llamar por cada trama.
+ * \param[in] connectionID Conexión por la que se recibieron los datos, se le pasa a \p handler.
+ *
+ */
+extern void binproto_decode(BinprotoDecoder * decoder, const uint8_t * data, uint16_t length,
+                            binprotoFrameHandler_type handler, uint8_t connectionID);
+
+
+/** \brief Arma una trama.
+ *
+ * \param[in] type Tipo de trama.
+ * \param[in] payload Datos de la trama.
+ * \param[in] length Cantidad de bytes de datos, como máximo \p BINPROTO_MAX_PAYLOAD.
+ * \param[out] out Buffer donde se escribe la trama, de al menos \p length + \p BINPROTO_OVERHEAD bytes.
+ * Puede ser el mismo buffer que \p payload desplazado en 3 bytes, ver \p binproto_encodeInPlace().
+ * \return Longitud de la trama.
+ *
+ */
+extern uint16_t binproto_encode(uint8_t type, const uint8_t * payload, uint8_t length, uint8_t * out);
+
+
+/** \brief Completa una trama cuyos datos ya fueron escritos a partir de \p frame + 3.
+ *
+ * Permite armar los datos directamente en su posición final, sin copias.
+ *
+ * \param[in] type Tipo de trama.
+ * \param[in] length Cantidad de bytes de datos.
+ * \param[inout] frame Buffer de la trama.
+ * \return Longitud de la trama.
+ *
+ */
+extern uint16_t binproto_encodeInPlace(uint8_t type, uint8_t length, uint8_t * frame);
+
+
+/** \brief Calcula el CRC-16/CCITT de un bloque de datos.
+ *
+ * \param[in] crc Valor inicial (0xFFFF para comenzar), permite calcularlo por partes.
+ * \param[in] data Datos.
+ * \param[in] length Cantidad de bytes.
+ * \return CRC resultante.
+ *
+ */
+extern uint16_t binproto_crc16(uint16_t crc, const uint8_t * data, uint16_t length);
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+
+#endif /* __BINARY_PROTOCOL_H_ */
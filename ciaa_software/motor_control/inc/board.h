@@ -0,0 +1,171 @@
+#ifndef __BOARD_H_
+#define __BOARD_H_
+
+ /** \addtogroup MotorControl
+ ** @{ */
+
+/** \brief Descripción de la placa: motores, encoders y las señales a las que están conectados.
+ *
+ * Es el único lugar donde se indica cuántos motores hay y a qué pines están
+ * conectados. A partir de estas tablas, el módulo PWM abre los canales de cada
+ * motor y el módulo Encoder configura los pines, los canales de interrupción
+ * y las interrupciones de cada encoder. Las rutinas de interrupción de los
+ * ocho canales PININT ya existen, por lo que para agregar motores sólo hace
+ * falta completar las tablas de board.c y definir \p BOARD_MOTOR_COUNT.
+ *
+ */
+
+ /** \defgroup Board Board
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+
+#include "ciaaPOSIX_stdio.h"  /* <= device handler header */
+
+/*==================[macros]=================================================*/
+
+/** \brief Manejo de las salidas PWM: 1 escribe directamente los registros de match del SCT,
+ * con resolución de 16 bits; 0 usa los dispositivos /dev/dio/pwm del driver POSIX, en %. */
+#ifndef BOARD_PWM_DIRECT
+#define BOARD_PWM_DIRECT			(1)
+#endif
+
+/** \brief Máxima cantidad de motores.
+ *
+ * Con \p BOARD_PWM_DIRECT el match 0 del SCT fija el período y cada señal usa
+ * otro de los 15 restantes, dos por motor: alcanzan para 7 motores. El tiempo
+ * muerto usa un match más por señal, por lo que sólo está disponible con hasta
+ * 3 motores.
+ *
+ * Los encoders también limitan la cantidad: el LPC43xx tiene ocho canales
+ * PININT, y un encoder de un canal (\p ENCODER_BACKEND_PININT) usa uno,
+ * uno en cuadratura por software (\p ENCODER_BACKEND_SOFT_QUADRATURE) usa dos
+ * y el QEI, que es uno solo, no usa ninguno.
+ *
+ */
+#if BOARD_PWM_DIRECT
+#define BOARD_MAX_MOTORS			(7)
+#else
+#define BOARD_MAX_MOTORS			(8)
+#endif
+
+/** \brief Cantidad de motores de la placa. Puede definirse al compilar (por ejemplo,
+ * -DBOARD_MOTOR_COUNT=4), siempre que board.c tenga las tablas para esa cantidad: hoy
+ * hay de 2 y de 4 motores.
+ *
+ * Con más de 3 motores y \p BOARD_PWM_DIRECT no quedan registros de match para el
+ * tiempo muerto, y \p ciaaPWM_setDeadTime() responde error. */
+#ifndef BOARD_MOTOR_COUNT
+#define BOARD_MOTOR_COUNT			(2)
+#endif
+
+#if BOARD_MOTOR_COUNT > BOARD_MAX_MOTORS
+#error "BOARD_MOTOR_COUNT no puede ser mayor que BOARD_MAX_MOTORS"
+#endif
+
+/** \brief Cantidad de encoders, uno por motor. */
+#define BOARD_ENCODER_COUNT			(BOARD_MOTOR_COUNT)
+
+/** \brief Cantidad de señales PWM, dos por motor (una por sentido). */
+#define BOARD_PWM_CHANNEL_COUNT		(BOARD_MOTOR_COUNT * 2)
+
+/** \brief Frecuencia de las señales PWM cuando se manejan directamente, en Hz. */
+#ifndef BOARD_PWM_FREQUENCY_HZ
+#define BOARD_PWM_FREQUENCY_HZ		(1000)
+#endif
+
+/** \brief Tiempo sin comandos de quien controla los motores tras el cual se detienen, en ms.
+ * 0 lo deshabilita; se cambia en ejecución con $DEADMAN=MS$. \see deadman.h */
+#ifndef BOARD_DEADMAN_TIMEOUT_MS
+#define BOARD_DEADMAN_TIMEOUT_MS	(1000)
+#endif
+
+/** \brief Ventana inicial de la detección de motores atascados, en ms. 0 la deshabilita;
+ * se cambia en ejecución con $ATASCO=MOTOR,DUTY,MS$. \see stall.h */
+#ifndef BOARD_STALL_WINDOW_MS
+#define BOARD_STALL_WINDOW_MS		(500)
+#endif
+
+/** \brief Encoders de las ruedas de tracción izquierda y derecha, usados por la odometría. */
+#ifndef BOARD_LEFT_ENCODER
+#define BOARD_LEFT_ENCODER			(0)
+#endif
+#ifndef BOARD_RIGHT_ENCODER
+#define BOARD_RIGHT_ENCODER			(1)
+#endif
+
+/** \brief Diámetro de las ruedas de tracción, en milímetros. */
+#ifndef BOARD_WHEEL_DIAMETER_MM
+#define BOARD_WHEEL_DIAMETER_MM		(65)
+#endif
+
+/** \brief Distancia entre las ruedas de tracción (trocha), en milímetros. */
+#ifndef BOARD_TRACK_WIDTH_MM
+#define BOARD_TRACK_WIDTH_MM		(130)
+#endif
+
+/*==================[typedef]================================================*/
+
+/** \brief Mecanismo de lectura de un encoder. */
+typedef enum {
+	ENCODER_BACKEND_PININT = 0,			/**< Flanco descendente del canal A, sin sentido de giro */
+	ENCODER_BACKEND_QEI,				/**< Periférico QEI, canales A y B en cuadratura */
+	ENCODER_BACKEND_SOFT_QUADRATURE		/**< Ambos flancos de los canales A y B, decodificados en las interrupciones */
+} EncoderBackend;
+
+
+/** \brief Conexión de un encoder. */
+typedef struct {
+	uint8_t	interruptChannel;
+	uint8_t portNumber;
+	uint8_t pinNumber;
+	uint8_t	gpio_portNumber;
+	uint8_t	gpio_pinNumber;
+	uint8_t diskSlotsNumber;
+	EncoderBackend backend;
+	/* Canal B, sólo para los encoders en cuadratura. En el QEI, pinFunction es la función
+	   de ambos pines, y los campos GPIO e interrupción no se usan. */
+	uint8_t	interruptChannelB;
+	uint8_t portNumberB;
+	uint8_t pinNumberB;
+	uint8_t	gpio_portNumberB;
+	uint8_t	gpio_pinNumberB;
+	uint8_t pinFunction;
+	uint16_t minPulseUS; /* Filtro inicial de pulsos cortos, \see encoder_setGlitchFilter() */
+} encoderConfigData;
+
+
+/** \brief Señal PWM: dispositivo del driver, salida del SCT y pin por el que sale. */
+typedef struct {
+	const char *	devicePath;
+	uint8_t			sctOutput;
+	/* Pin de la salida CTOUT, sólo con BOARD_PWM_DIRECT (el driver POSIX configura los suyos) */
+	uint8_t			portNumber;
+	uint8_t			pinNumber;
+	uint8_t			pinFunction;
+} pwmChannelConfigData;
+
+
+/** \brief Señales PWM de un motor, como índices de \p boardPwmChannels. */
+typedef struct {
+	uint8_t	forwardChannel;
+	uint8_t	backwardChannel;
+} motorConfigData;
+
+/*==================[external data declaration]==============================*/
+
+/** \brief Señales PWM de la placa. */
+extern const pwmChannelConfigData boardPwmChannels[BOARD_PWM_CHANNEL_COUNT];
+
+/** \brief Señales de cada motor. */
+extern const motorConfigData boardMotors[BOARD_MOTOR_COUNT];
+
+/** \brief Encoder de cada motor, en el mismo orden que \p boardMotors. */
+extern const encoderConfigData boardEncoders[BOARD_ENCODER_COUNT];
+
+/*==================[external functions declaration]=========================*/
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+
+#endif /* __BOARD_H_ */
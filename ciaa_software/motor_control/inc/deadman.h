@@ -0,0 +1,83 @@
+#ifndef __DEADMAN_H_
+#define __DEADMAN_H_
+
+ /** \addtogroup MotorControl
+ ** @{ */
+
+/** \brief Detención de los motores por falta de comandos (hombre muerto).
+ *
+ * Cada vez que llegan datos de quien controla los motores se llama a
+ * \p deadman_feed(). Si pasa el tiempo configurado sin datos, desde
+ * EncoderTask se detienen los motores sin esperar a que se cierre la conexión
+ * TCP:
+ *
+ * - Los motores con límites de aceleración (\see speedControl_setLimits())
+ *   bajan su ciclo de trabajo a 0 con una rampa.
+ * - El resto se cortan en la misma muestra.
+ *
+ * El guion en ejecución se detiene. La detención comienza como mucho un
+ * período de muestreo después de vencido el tiempo. Un cliente que no tiene
+ * comandos para enviar, por ejemplo mientras corre un guion, mantiene viva la
+ * conexión con $PING$.
+ *
+ * La detención está habilitada desde el inicio (\see BOARD_DEADMAN_TIMEOUT_MS),
+ * así un cliente que se cuelga antes de configurarla no deja los motores en
+ * marcha.
+ *
+ */
+
+ /** \defgroup Deadman Deadman
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+
+#include "ciaaPOSIX_stdio.h"  /* <= device handler header */
+
+/*==================[macros]=================================================*/
+
+/*==================[typedef]================================================*/
+
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+
+/** \brief Inicializa el módulo con el tiempo de \p BOARD_DEADMAN_TIMEOUT_MS. */
+extern void deadman_init(void);
+
+
+/** \brief Fija el tiempo sin comandos tras el cual se detienen los motores.
+ *
+ * \param[in] timeoutMS Tiempo en ms, 0 deshabilita la detención.
+ *
+ */
+extern void deadman_setTimeout(uint16_t timeoutMS);
+
+
+/** \brief Obtiene el tiempo sin comandos configurado, en ms. */
+extern uint16_t deadman_getTimeout(void);
+
+
+/** \brief Indica que llegaron datos de quien controla los motores y arma la detención. */
+extern void deadman_feed(void);
+
+
+/** \brief Desarma la detención hasta el próximo \p deadman_feed(), por ejemplo al apagar los motores. */
+extern void deadman_disarm(void);
+
+
+/** \brief Verifica el tiempo transcurrido y detiene los motores si venció.
+ *
+ * Debe llamarse desde EncoderTask en cada período de muestreo, antes del
+ * guion y del control de velocidad, \see encoder_setSampleCallback().
+ *
+ */
+extern void deadman_update(void);
+
+
+/** \brief Obtiene la cantidad de veces que se detuvieron motores en movimiento por falta de comandos. */
+extern uint32_t deadman_getTrips(void);
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+
+#endif /* __DEADMAN_H_ */
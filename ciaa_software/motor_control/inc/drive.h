@@ -0,0 +1,66 @@
+#ifndef __DRIVE_H_
+#define __DRIVE_H_
+
+ /** \addtogroup MotorControl
+ ** @{ */
+
+/** \brief Cinemática inversa del robot diferencial.
+ *
+ * Convierte una velocidad del cuerpo (lineal y angular) en las consignas de
+ * velocidad de las ruedas de tracción (\see BOARD_LEFT_ENCODER), que se fijan
+ * juntas en el control de velocidad:
+ *
+ \verbatim
+    v_izquierda = v - w * trocha / 2
+    v_derecha   = v + w * trocha / 2
+    RPM         = v_rueda * 60 / (pi * diametro)
+ \endverbatim
+ *
+ * La conversión de mm/s a décimas de RPM usa un factor en Q16 calculado al
+ * cambiar la geometría, por lo que cada comando cuesta dos multiplicaciones.
+ * La geometría es la misma que usa la odometría.
+ *
+ */
+
+ /** \defgroup Drive Drive
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+
+#include "ciaaPOSIX_stdio.h"  /* <= device handler header */
+
+/*==================[macros]=================================================*/
+
+/*==================[typedef]================================================*/
+
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+
+/** \brief Configuración inicial, con la geometría de board.h. */
+extern void drive_init(void);
+
+
+/** \brief Configura la geometría del robot, también para la odometría.
+ *
+ * \param[in] wheelDiameterMM Diámetro de las ruedas de tracción en milímetros.
+ * \param[in] trackWidthMM Distancia entre las ruedas de tracción en milímetros.
+ * \return Si es negativo, algún valor era 0 o el diámetro era demasiado grande.
+ *
+ */
+extern int32_t drive_setGeometry(uint16_t wheelDiameterMM, uint16_t trackWidthMM);
+
+
+/** \brief Fija la velocidad del robot.
+ *
+ * \param[in] linearMMS Velocidad lineal en mm/s, positiva hacia adelante.
+ * \param[in] angularMradS Velocidad angular en milirradianes/s, positiva en sentido antihorario.
+ * \return Si es negativo, no se pudieron fijar las consignas.
+ *
+ */
+extern int32_t drive_setVelocity(int32_t linearMMS, int32_t angularMradS);
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+
+#endif /* __DRIVE_H_ */
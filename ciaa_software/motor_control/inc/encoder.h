@@ -11,6 +11,24 @@
  * tiempo, es posible traducir la cantidad de interrupciones en unidades de
  * velocidad, útiles para el usuario.
  *
+ * Cada encoder se lee con uno de los siguientes mecanismos, elegido en su configuración:
+ *
+ * - Interrupción por flanco descendente de un único canal (PININT). No se conoce el sentido
+ * de giro, por lo que se toma el indicado mediante \p encoder_setDirectionHint().
+ * - Periférico QEI, con los canales A y B en cuadratura. El conteo lo realiza el hardware,
+ * con resolución 4x y sin costo de CPU por flanco. El LPC43xx tiene un único QEI.
+ * - Decodificador A/B por software, mediante interrupciones en ambos flancos de ambos canales.
+ * También tiene resolución 4x y conoce el sentido, pero cada flanco genera una interrupción.
+ *
+ * En todos los casos \p encoder_getLastCount() devuelve la cantidad de flancos contados en
+ * el período, mientras que \p encoder_getPosition() y \p encoder_getVelocity() devuelven
+ * valores con signo.
+ *
+ * La posición de cada encoder se muestrea con un período configurable (de hasta 1 ms),
+ * y las últimas \p ENCODER_HISTORY_LENGTH muestras se conservan en un buffer circular,
+ * sobre el que se calculan promedios de cualquier ventana con \p encoder_getWindowSpeed().
+ * Independientemente del muestreo, se notifica al usuario con el período de conteo:
+ *
  * El proceso de captura de interrupciones es periódico, siendo a grandes rasgos
  * así:
  *
@@ -51,11 +69,40 @@
 /*==================[inclusions]=============================================*/
 
 #include "ciaaPOSIX_stdio.h"  /* <= device handler header */
+#include "board.h"
 
 /*==================[macros]=================================================*/
 
 /** \brief Cantidad de encoders conectados. */
-#define ENCODER_COUNT   (2)
+#define ENCODER_COUNT   (BOARD_ENCODER_COUNT)
+
+/** \brief Período de muestreo inicial, en milisegundos. \see encoder_setSamplePeriod() */
+#define ENCODER_DEFAULT_SAMPLE_PERIOD_MS	(10)
+
+/** \brief Período de muestreo máximo, en milisegundos: el MAXALLOWEDVALUE del contador
+ * SoftwareCounter del OIL, que maneja la alarma de EncoderTask. */
+#define ENCODER_MAX_SAMPLE_PERIOD_MS		(10000)
+
+/** \brief Cantidad de muestras que se conservan de cada encoder. */
+#define ENCODER_HISTORY_LENGTH			(256)
+
+/** \brief Cantidad de entradas del buffer de traza de cada encoder, debe ser potencia de 2. */
+#define ENCODER_TRACE_LENGTH			(128)
+
+/** \brief Bit de una entrada de traza que indica que el flanco fue en sentido hacia atrás. */
+#define ENCODER_TRACE_BACKWARD			(0x80000000UL)
+
+/** \brief Tiempo sin flancos luego del cual se considera detenido al motor, en milisegundos. */
+#define ENCODER_EDGE_TIMEOUT_MS			(500)
+
+/** \brief Alfa inicial del observador de velocidad, en milésimas. \see encoder_setObserverGain() */
+#define ENCODER_DEFAULT_OBSERVER_ALPHA	(250)
+
+/** \brief Flancos por período a partir de los cuales \p SPEED_TYPE_EDGE_TIMED pasa a calcularse por conteo. */
+#define ENCODER_COUNT_MODE_ENTER		(32)
+
+/** \brief Flancos por período por debajo de los cuales \p SPEED_TYPE_EDGE_TIMED vuelve a medir el tiempo entre flancos. */
+#define ENCODER_COUNT_MODE_EXIT			(16)
 
 /*==================[typedef]================================================*/
 
@@ -69,10 +116,16 @@
 typedef void (*callBackTimeElapsedFunction_type)(void);
 
 
-/** \brief Unidades para los datos que podría utilizar este módulo. Actualmente, sólo se usa SPEED_TYPE_INTERRUPTS. */
+/** \brief Tipo de función llamada por el módulo en cada período de muestreo, desde EncoderTask. */
+typedef void (*callBackSampleFunction_type)(void);
+
+
+/** \brief Unidades para los datos que podría utilizar este módulo. \see encoder_getSpeed() */
 typedef enum {
-    SPEED_TYPE_RPM          = 0,
-    SPEED_TYPE_INTERRUPTS   = 1
+    SPEED_TYPE_RPM          = 0, /**< RPM, a partir de la cuenta del último período. */
+    SPEED_TYPE_INTERRUPTS   = 1, /**< Cantidad de interrupciones del último período. */
+    SPEED_TYPE_EDGE_TIMED   = 2, /**< Décimas de RPM, a partir del tiempo entre los dos últimos flancos. */
+    SPEED_TYPE_OBSERVED     = 3  /**< Décimas de RPM, estimadas por el observador alfa-beta en cada muestra. */
 } SpeedType;
 
 /*==================[external data declaration]==============================*/
@@ -88,8 +141,11 @@ typedef enum {
  * activar interrupciones para cada uno de estos pines, que son disparadas por el flanco
  * descendente de la señal de entrada.
  *
+ * \return Si es negativo, la descripción de la placa es inválida: más de un encoder usa
+ * el QEI, que es uno solo.
+ *
  */
-extern void encoder_init(void);
+extern int32_t encoder_init(void);
 
 
 /** \brief Inicia el conteo periódico de interrupciones.
@@ -108,13 +164,30 @@ extern void encoder_init(void);
  * el nuevo período escogido.
  *
  * \param[in] periodMS Tiempo durante el cual se medirán interrupciones antes de notificar
- * al usuario. El valor máximo que puede tomar depende del valor máximo del contador
- * asociado a la alarma que activa la tarea periódica.
+ * al usuario. Se redondea hacia abajo a un múltiplo del período de muestreo, con un
+ * mínimo de una muestra.
  *
  */
 extern void encoder_beginCount(uint16_t periodMS);
 
 
+/** \brief Cambia el período de muestreo de los encoders.
+ *
+ * Si el conteo está en curso, se reinicia con el período de conteo pedido en
+ * \p encoder_beginCount(). Como las muestras anteriores corresponden a otro período,
+ * EncoderTask descarta la historia antes de su próxima muestra.
+ *
+ * \param[in] periodMS Período de muestreo en milisegundos, de 1 a \p ENCODER_MAX_SAMPLE_PERIOD_MS.
+ * \return Si es negativo, el período era inválido o no se pudo reiniciar la alarma.
+ *
+ */
+extern int32_t encoder_setSamplePeriod(uint16_t periodMS);
+
+
+/** \brief Período de muestreo actual, en milisegundos. */
+extern uint16_t encoder_getSamplePeriod(void);
+
+
 /** \brief Registra una función para la notificación TimeElapsed.
  *
  * La función registrada será llamada al ocurrir el evento.
@@ -127,6 +200,21 @@ extern void encoder_beginCount(uint16_t periodMS);
 extern void encoder_setTimeElapsedCallback(callBackTimeElapsedFunction_type fcnPtr);
 
 
+/** \brief Registra una función a llamar en cada período de muestreo.
+ *
+ * Se llama desde EncoderTask luego de tomar la muestra de todos los encoders, por lo que
+ * \p encoder_getSamplePosition() devuelve posiciones tomadas en el mismo instante.
+ *
+ * \param[in] fcnPtr puntero a la función a llamar, o 0 para no llamar a ninguna.
+ *
+ */
+extern void encoder_setSampleCallback(callBackSampleFunction_type fcnPtr);
+
+
+/** \brief Posición del encoder en la última muestra, \see encoder_setSampleCallback(). */
+extern int32_t encoder_getSamplePosition(uint8_t encoderID);
+
+
 /** \brief Obtiene la cantidad de interrupciones generadas por el encoder contadas durante un período.
  *
  * \param[in] encoderID Identificador de encoder del cual se desea obtener la cantidad
@@ -135,12 +223,182 @@ extern void encoder_setTimeElapsedCallback(callBackTimeElapsedFunction_type fcnP
  * especificado.
  *
  */
-extern uint16_t encoder_getLastCount(uint8_t encoderID);
+extern uint32_t encoder_getLastCount(uint8_t encoderID);
 
 
 /** \brief Reinicia el conteo actual de interrupciones para todos los encoders. */
 extern void encoder_resetCount(void);
 
+
+/** \brief Obtiene la posición acumulada del encoder, en flancos contados desde el inicio.
+ *
+ * \param[in] encoderID Identificador de encoder.
+ * \return Posición con signo, positiva hacia adelante.
+ *
+ */
+extern int32_t encoder_getPosition(uint8_t encoderID);
+
+
+/** \brief Obtiene la velocidad del encoder, como variación de la posición durante el último período.
+ *
+ * \param[in] encoderID Identificador de encoder.
+ * \return Flancos por período de conteo, con signo.
+ *
+ */
+extern int32_t encoder_getVelocity(uint8_t encoderID);
+
+
+/** \brief Cantidad de flancos contados por cada vuelta del disco del encoder.
+ *
+ * Depende de la cantidad de ranuras del disco y de la resolución del mecanismo
+ * de lectura (1x con un único canal, 4x en cuadratura).
+ *
+ */
+extern uint16_t encoder_getCountsPerRevolution(uint8_t encoderID);
+
+
+/** \brief Indica el sentido de giro a usar para los encoders de un único canal.
+ *
+ * Un encoder de un único canal no puede detectar el sentido de giro, por lo que se
+ * asume el del ciclo de trabajo aplicado al motor. Los encoders en cuadratura ignoran
+ * esta indicación.
+ *
+ * \param[in] encoderID Identificador de encoder.
+ * \param[in] sign 1 hacia adelante, -1 hacia atrás.
+ *
+ */
+extern void encoder_setDirectionHint(uint8_t encoderID, int8_t sign);
+
+
+/** \brief Configura el observador de velocidad de todos los encoders.
+ *
+ * En cada período de muestreo, EncoderTask actualiza un observador alfa-beta (\see observer.h)
+ * por encoder con la posición medida, interpolada entre cuentas con el tiempo transcurrido
+ * desde el último flanco. Su velocidad, \p SPEED_TYPE_OBSERVED, no tiene la cuantización de
+ * contar flancos en una ventana ni su retardo de media ventana. El observador se actualiza
+ * con la frecuencia de muestreo, \see encoder_setSamplePeriod().
+ *
+ * \param[in] alphaMilli Alfa en milésimas, de 1 a 999. Valores bajos dan una velocidad más
+ * suave, valores altos siguen más rápido sus cambios.
+ * \return Si es negativo, el valor era inválido.
+ *
+ */
+extern int32_t encoder_setObserverGain(uint16_t alphaMilli);
+
+
+/** \brief Configura el filtro de pulsos cortos de un encoder.
+ *
+ * Los pines siempre tienen habilitado el filtro de glitches del SCU, que descarta
+ * en hardware los pulsos de pocos nanosegundos. Además, con el filtro habilitado:
+ * - Con \p ENCODER_BACKEND_PININT, la interrupción descarta el flanco si el pin ya
+ *   volvió a estar en alto (un pulso más corto que la latencia de la interrupción),
+ *   o si ocurrió a menos de \p minPulseUS del último flanco aceptado (un rebote).
+ * - Con \p ENCODER_BACKEND_QEI, cada fase debe mantenerse estable \p minPulseUS
+ *   para que el QEI la acepte, sin ninguna interrupción.
+ * - Con \p ENCODER_BACKEND_SOFT_QUADRATURE no se usa: un rebote suma y resta en la
+ *   tabla de decodificación, y las transiciones inválidas siempre se descartan.
+ *
+ * Los flancos descartados no modifican la posición, la cuenta ni el tiempo entre
+ * flancos, y se cuentan en \p encoder_getRejectedEdges(). El valor inicial de cada
+ * encoder es el de la descripción de la placa.
+ *
+ * \param[in] encoderID Identificador de encoder.
+ * \param[in] minPulseUS Ancho mínimo de pulso en microsegundos, 0 deshabilita el filtro.
+ * Debe ser menor que el tiempo entre flancos a la máxima velocidad del motor.
+ * \return Si es negativo, el encoder era inválido.
+ *
+ */
+extern int32_t encoder_setGlitchFilter(uint8_t encoderID, uint16_t minPulseUS);
+
+
+/** \brief Ancho mínimo de pulso configurado para un encoder, en microsegundos. */
+extern uint16_t encoder_getGlitchFilter(uint8_t encoderID);
+
+
+/** \brief Cantidad de flancos descartados por el filtro de pulsos cortos o por ser transiciones inválidas. */
+extern uint32_t encoder_getRejectedEdges(uint8_t encoderID);
+
+
+/** \brief Obtiene la velocidad del encoder en las unidades pedidas.
+ *
+ * Con \p SPEED_TYPE_EDGE_TIMED, a baja velocidad se usa el tiempo entre los dos
+ * últimos flancos, tomado en la interrupción con \p timestamp_now(). El valor está
+ * disponible en cuanto ocurre cada flanco, sin esperar al fin del período de conteo,
+ * y si pasa más tiempo que el último intervalo sin un nuevo flanco, la velocidad
+ * decae en consecuencia hasta llegar a 0 luego de \p ENCODER_EDGE_TIMEOUT_MS.
+ * A alta velocidad, cuando el período contiene al menos \p ENCODER_COUNT_MODE_ENTER
+ * flancos, se usa la cuenta del período, que promedia las irregularidades del disco.
+ * Los encoders leídos por el QEI siempre usan la cuenta.
+ *
+ * \param[in] encoderID Identificador de encoder.
+ * \param[in] type Unidades del resultado.
+ * \return Velocidad con signo, positiva hacia adelante (salvo \p SPEED_TYPE_INTERRUPTS).
+ *
+ */
+extern int32_t encoder_getSpeed(uint8_t encoderID, SpeedType type);
+
+
+/** \brief Obtiene la velocidad promedio del encoder durante las últimas muestras.
+ *
+ * \param[in] encoderID Identificador de encoder.
+ * \param[in] windowMS Duración de la ventana en milisegundos. Se redondea a una cantidad
+ * entera de muestras, y se limita a las muestras disponibles en la historia.
+ * \param[in] type \p SPEED_TYPE_RPM o \p SPEED_TYPE_EDGE_TIMED (décimas de RPM) dan el
+ * promedio con signo; \p SPEED_TYPE_INTERRUPTS, la cantidad de flancos en la ventana.
+ * \return Velocidad promedio, o 0 si todavía no hay muestras.
+ *
+ */
+extern int32_t encoder_getWindowSpeed(uint8_t encoderID, uint16_t windowMS, SpeedType type);
+
+
+/** \brief Habilita o deshabilita la traza de flancos.
+ *
+ * Con la traza habilitada, la interrupción de cada flanco guarda en un buffer circular
+ * del encoder los ciclos de reloj transcurridos desde el flanco anterior (\see timestamp.h),
+ * con el bit \p ENCODER_TRACE_BACKWARD en 1 si el flanco fue hacia atrás. Si el buffer está
+ * lleno, el flanco no se guarda y se incrementa el contador de desbordes.
+ *
+ * La interrupción es la única que escribe el buffer, y una única tarea de menor prioridad
+ * lo lee con \p encoder_peekTrace() y \p encoder_consumeTrace(), por lo que no se necesita
+ * deshabilitar interrupciones. Esta función y \p encoder_consumeTrace() toman el resource
+ * TRACER de OSEK: la tarea que llame a cualquiera de las dos debe declararlo en el OIL.
+ *
+ * \param[in] encoderMask Máscara de encoders a trazar, 0 deshabilita la traza. Los encoders
+ * que se habilitan comienzan con su buffer vacío y el contador de desbordes en 0.
+ *
+ */
+extern void encoder_setTraceMask(uint8_t encoderMask);
+
+
+/** \brief Copia entradas de la traza de un encoder, sin quitarlas del buffer.
+ *
+ * \param[in] encoderID Identificador de encoder.
+ * \param[out] buf Donde se copian las entradas, de la más antigua a la más nueva.
+ * \param[in] maxEntries Máxima cantidad de entradas a copiar.
+ * \return Cantidad de entradas copiadas.
+ *
+ */
+extern uint16_t encoder_peekTrace(uint8_t encoderID, uint32_t * buf, uint16_t maxEntries);
+
+
+/** \brief Obtiene la generación del buffer de traza de un encoder, que cambia cada vez que se reinicia. */
+extern uint16_t encoder_getTraceGeneration(uint8_t encoderID);
+
+
+/** \brief Quita del buffer de traza las entradas más antiguas, ya enviadas.
+ *
+ * \param[in] encoderID Identificador de encoder.
+ * \param[in] entries Cantidad de entradas.
+ * \param[in] generation Generación leída antes de \p encoder_peekTrace(). Si el buffer se
+ * reinició desde entonces (\see encoder_setTraceMask()), no se quita ninguna entrada.
+ *
+ */
+extern void encoder_consumeTrace(uint8_t encoderID, uint16_t entries, uint16_t generation);
+
+
+/** \brief Cantidad de flancos que no se guardaron en la traza por tener el buffer lleno. */
+extern uint32_t encoder_getTraceOverflows(uint8_t encoderID);
+
 /** @} doxygen end group definition */
 /** @} doxygen end group definition */
 
@@ -102,6 +102,9 @@ typedef enum {
 	AT_CIPSEND,
 	AT_CIPSENDEX,
 	AT_CIPSENDBUF,
+	AT_GMR,
+	AT_UART_CUR,
+	AT_CIPMODE,
 	AT_COMMAND_SIZE
 } AT_Command;
 
@@ -166,6 +169,13 @@ typedef struct {
 } AT_CIPSEND_DATA;
 
 
+/** \brief Fragmento de datos a enviar con \p esp8266_queueSendParts(). */
+typedef struct {
+    const char *        content; /**< Puntero al fragmento. */
+    uint16_t            length; /**< Cantidad de bytes del fragmento. */
+} AT_CIPSEND_PART;
+
+
 /** \brief Parámetro para el comando AT+CIPMUX */
 typedef enum {
     AT_CIPMUX_SINGLE_CONNECTION     = 0,
@@ -210,6 +220,23 @@ typedef struct {
 } AT_CWSAP_DATA;
 
 
+/** \brief Funcionalidades del firmware AT detectadas por \p esp8266_queueProbe().
+ *
+ * Las distintas versiones del firmware AT del ESP8266 no soportan los mismos
+ * comandos. Cada bit indica si la funcionalidad está disponible.
+ *
+ */
+typedef enum {
+    ESP8266_CAP_CIPSENDBUF  = 1 << 0, /**< AT+CIPSENDBUF, envío sin esperar a que se transmita el anterior. */
+    ESP8266_CAP_CIPSENDEX   = 1 << 1, /**< AT+CIPSENDEX. */
+    ESP8266_CAP_CWSAP_CUR   = 1 << 2, /**< AT+CWSAP_CUR, configuración del AP sin escribir la flash. */
+    ESP8266_CAP_UART_CUR    = 1 << 3, /**< AT+UART_CUR, cambio de baud rate sin escribir la flash. */
+    ESP8266_CAP_CIPMODE     = 1 << 4, /**< AT+CIPMODE, modo transparente. */
+    ESP8266_CAP_SEND_OK     = 1 << 5, /**< Informa "SEND OK" al completar un envío (firmware AT 0.40 o superior). */
+    ESP8266_CAP_SEGMENT_ID  = 1 << 6, /**< AT+CIPSENDBUF informa el número de segmento de cada envío (firmware AT 1.0 o superior). */
+    ESP8266_CAP_PROBED      = 1 << 7  /**< El sondeo finalizó; los demás bits son válidos. */
+} ESP8266_Capability;
+
 /** @} doxygen end group definition */
 
 
@@ -349,6 +376,68 @@ extern void esp8266_doWork(void);
 extern int32_t esp8266_queueCommand(AT_Command command, AT_Type type, void* parameters);
 
 
+/** \brief Encola los comandos que detectan las funcionalidades del firmware AT.
+ *
+ * Envía AT+GMR y comandos de prueba (AT+CIPSENDBUF=?, AT+CWSAP_CUR=?, etc.), y a
+ * medida que se reciben las respuestas registra qué funcionalidades existen.
+ * Debe llamarse luego de cada reinicio del módulo WiFi, antes de encolar otros
+ * comandos.
+ *
+ * Una vez finalizado el sondeo, los comandos encolados se adaptan a lo disponible:
+ * cualquier variante de AT+CIPSEND se envía con la más rápida que exista
+ * (AT+CIPSENDBUF, luego AT+CIPSENDEX, luego AT+CIPSEND), y AT+CWSAP_CUR se reemplaza
+ * por AT+CWSAP si no está soportado. Mientras el sondeo no haya finalizado, los
+ * comandos se envían tal como fueron encolados.
+ *
+ */
+extern void esp8266_queueProbe(void);
+
+
+/** \brief Obtiene las funcionalidades detectadas del firmware AT.
+ *
+ * \return Máscara de bits de \p ESP8266_Capability.
+ *
+ */
+extern uint8_t esp8266_getCapabilities(void);
+
+
+/** \brief Obtiene la versión del firmware AT informada por AT+GMR.
+ *
+ * \return Versión mayor en el byte alto y menor en el byte bajo, o 0 si no se conoce.
+ *
+ */
+extern uint16_t esp8266_getFirmwareVersion(void);
+
+
+/** \brief Encola el envío de varios fragmentos como un único mensaje.
+ *
+ * Equivale a encolar AT+CIPSENDBUF con el contenido copiado al buffer interno,
+ * pero el contenido se arma concatenando los fragmentos dados. Permite que un
+ * mismo dato, armado una sola vez, sea enviado a distintas conexiones con
+ * distintos encabezados sin copias intermedias.
+ *
+ * \param[in] connectionID Número de conexión a la cual se le enviarán los datos.
+ * \param[in] parts Fragmentos a enviar, en orden.
+ * \param[in] count Cantidad de fragmentos.
+ * \return Si retorna un valor negativo ocurrió un error al encolar el comando (por
+ * ejemplo, no hay lugar en el buffer interno), de lo contrario, la operación fue exitosa.
+ *
+ */
+extern int32_t esp8266_queueSendParts(uint8_t connectionID, const AT_CIPSEND_PART * parts, uint8_t count);
+
+
+/** \brief Cantidad de envíos de datos encolados y todavía no finalizados para una conexión.
+ *
+ * Permite detectar conexiones lentas, para descartar datos en lugar de acumularlos
+ * en la cola de comandos.
+ *
+ * \param[in] connectionID identificador de conexión.
+ * \return Cantidad de comandos AT+CIPSEND (en cualquiera de sus variantes) pendientes.
+ *
+ */
+extern uint8_t esp8266_getPendingSends(uint8_t connectionID);
+
+
 /** \brief Especifica el buffer a utilizar para la recepción de datos de usuario.
  *
  * Brinda una manera de especificar qué buffer será usado para almacenar datos que
@@ -40,6 +40,8 @@
 
 /*==================[inclusions]=============================================*/
 
+#include "board.h"
+
 /*==================[macros]=================================================*/
 
 /** \brief Bitmask para acceder a bit que controla el pin ENABLE12 del puente H. */
@@ -57,8 +59,18 @@
 /** \brief Tamaño en bytes del buffer usado para la recepción de datos que fueron recibidos por el módulo WiFi. */
 #define RECEIVE_BUFFER_LENGTH   	(2048)
 
-/** \brief Cantidad de motores que se manejarán */
-#define MOTOR_COUNT					(2)
+/** \brief Cantidad de motores que se manejarán, definida en la descripción de la placa. */
+#define MOTOR_COUNT					(BOARD_MOTOR_COUNT)
+
+/** \brief Impide que el compilador mueva accesos a memoria de un lado al otro.
+ *
+ * Se usa antes de escribir la bandera volatile que publica datos para otra
+ * tarea: sin ella, las escrituras de los datos no volatile pueden quedar
+ * después de la bandera. Con un único núcleo no hace falta una barrera de
+ * hardware.
+ *
+ */
+#define COMPILER_BARRIER()			__asm volatile ("" ::: "memory")
 
 /*==================[typedef]================================================*/
 
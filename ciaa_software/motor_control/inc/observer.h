@@ -0,0 +1,96 @@
+#ifndef __OBSERVER_H_
+#define __OBSERVER_H_
+
+ /** \addtogroup MotorControl
+ ** @{ */
+
+/** \brief Observador alfa-beta de posición y velocidad, en punto fijo.
+ *
+ * En cada muestra predice la posición con la velocidad estimada y corrige
+ * ambas con el residuo respecto de la posición medida:
+ *
+ \verbatim
+    prediccion = posicion + velocidad
+    residuo    = medicion - prediccion
+    posicion   = prediccion + alfa * residuo
+    velocidad  = velocidad  + beta * residuo
+ \endverbatim
+ *
+ * Es el estado estacionario de un filtro de Kalman de velocidad constante.
+ * Beta se obtiene de alfa con la relación de Benedict-Bordner,
+ * beta = alfa^2 / (2 - alfa), que da una respuesta sin sobrepico.
+ *
+ * Las posiciones están en Q16 (cuentas * 65536) sin signo y dan la vuelta en
+ * 32 bits: sólo se usan sus diferencias, que son válidas mientras el residuo
+ * sea menor que 32768 cuentas. La velocidad está en Q16 cuentas por muestra.
+ * Cada actualización usa dos multiplicaciones de 32x32 bits, sin divisiones.
+ * Su costo en la placa, para todos los encoders, es la sección \p PERF_OBSERVER
+ * que responde $PERF$ (\see perf.h).
+ *
+ */
+
+ /** \defgroup Observer Observer
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+
+#include "ciaaPOSIX_stdio.h"  /* <= device handler header */
+
+/*==================[macros]=================================================*/
+
+/** \brief Bits fraccionarios de las posiciones, velocidades y ganancias. */
+#define OBSERVER_Q_BITS			(16)
+
+/** \brief Valor 1 en Q16. */
+#define OBSERVER_ONE			(1UL << OBSERVER_Q_BITS)
+
+/** \brief Convierte una cantidad de cuentas a una posición Q16. */
+#define observer_toQ16(counts)	((uint32_t)(counts) << OBSERVER_Q_BITS)
+
+/*==================[typedef]================================================*/
+
+/** \brief Estado estimado. */
+typedef struct {
+	uint32_t	position; /**< Q16 cuentas, da la vuelta. */
+	int32_t		velocity; /**< Q16 cuentas por muestra. */
+} ObserverState;
+
+
+/** \brief Ganancias del observador, en Q16. */
+typedef struct {
+	int32_t		alpha;
+	int32_t		beta;
+} ObserverGains;
+
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+
+/** \brief Calcula las ganancias a partir de alfa.
+ *
+ * \param[out] gains Ganancias calculadas.
+ * \param[in] alphaMilli Alfa en milésimas, de 1 a 999. Valores bajos filtran más el ruido
+ * de cuantización, valores altos siguen más rápido los cambios de velocidad.
+ * \return Si es negativo, alfa era inválido y no se modificaron las ganancias.
+ *
+ */
+extern int32_t observer_setGains(ObserverGains * gains, uint16_t alphaMilli);
+
+
+/** \brief Reinicia el estado en una posición, con velocidad nula. */
+extern void observer_reset(ObserverState * state, uint32_t position);
+
+
+/** \brief Actualiza el estado con una nueva medición.
+ *
+ * \param[inout] state Estado del observador.
+ * \param[in] gains Ganancias.
+ * \param[in] measurement Posición medida, en Q16 cuentas.
+ *
+ */
+extern void observer_update(ObserverState * state, const ObserverGains * gains, uint32_t measurement);
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+
+#endif /* __OBSERVER_H_ */
@@ -0,0 +1,89 @@
+#ifndef __ODOMETRY_H_
+#define __ODOMETRY_H_
+
+ /** \addtogroup MotorControl
+ ** @{ */
+
+/** \brief Odometría por navegación a estima con los encoders de las dos ruedas.
+ *
+ * En cada período de muestreo de los encoders integra el desplazamiento de
+ * la rueda izquierda y de la derecha (\see BOARD_LEFT_ENCODER) en la posición
+ * x, y y la orientación del robot, en punto fijo. El avance es el promedio de
+ * ambas ruedas, y el giro su diferencia dividida por la trocha; el avance se
+ * proyecta con la orientación a mitad de la muestra.
+ *
+ * La orientación es un ángulo binario de 32 bits (2^32 es una vuelta), que da
+ * la vuelta sin operaciones adicionales, y el seno y el coseno se obtienen de
+ * una tabla de un cuarto de onda con interpolación lineal. La posición se
+ * acumula en Q16 milímetros.
+ *
+ * La pose comienza en (0, 0) con orientación 0 (hacia el eje x) al inicio y
+ * cada vez que se reinicia.
+ *
+ */
+
+ /** \defgroup Odometry Odometry
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+
+#include "ciaaPOSIX_stdio.h"  /* <= device handler header */
+
+/*==================[macros]=================================================*/
+
+/*==================[typedef]================================================*/
+
+/** \brief Pose del robot. */
+typedef struct {
+	int32_t		xMM;
+	int32_t		yMM;
+	uint16_t	headingMrad; /**< Orientación en milirradianes, de 0 a 6282, positiva en sentido antihorario. */
+} OdometryPose;
+
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+
+/** \brief Configuración inicial del módulo, con la pose en el origen. */
+extern void odometry_init(void);
+
+
+/** \brief Integra el desplazamiento de la última muestra de los encoders.
+ *
+ * Debe llamarse desde EncoderTask en cada período de muestreo, \see encoder_setSampleCallback().
+ *
+ */
+extern void odometry_update(void);
+
+
+/** \brief Vuelve la pose al origen.
+ *
+ * Puede llamarse desde cualquier tarea: el reinicio se aplica en la próxima muestra.
+ *
+ */
+extern void odometry_reset(void);
+
+
+/** \brief Cambia la geometría de las ruedas, inicialmente la de board.h.
+ *
+ * Puede llamarse desde cualquier tarea: se aplica en la próxima muestra.
+ *
+ * \param[in] wheelDiameterMM Diámetro de las ruedas de tracción en milímetros.
+ * \param[in] trackWidthMM Distancia entre las ruedas de tracción en milímetros.
+ * \return Si es negativo, algún valor era 0 o el diámetro era demasiado grande.
+ *
+ */
+extern int32_t odometry_setGeometry(uint16_t wheelDiameterMM, uint16_t trackWidthMM);
+
+
+/** \brief Obtiene la pose actual.
+ *
+ * Puede llamarse desde cualquier tarea de menor prioridad que EncoderTask.
+ *
+ */
+extern void odometry_getPose(OdometryPose * pose);
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+
+#endif /* __ODOMETRY_H_ */
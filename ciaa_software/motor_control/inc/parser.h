@@ -76,6 +76,8 @@ typedef enum {
     LITERAL_PARSER,
     AT_MSG_RESET,
     USER_CARACTERIZAR,
+    USER_COMANDO,
+    AT_MSG_GMR,
     PARSER_TYPES_COUNT
 } ParserType;
 
@@ -111,6 +113,8 @@ struct Parser_struct {
 #include "user_cmd/dutycycle.h"
 #include "at_cmd/reset_detection.h"
 #include "user_cmd/caracterizar.h"
+#include "user_cmd/comando.h"
+#include "at_cmd/gmr.h"
 
 /*==================[external data declaration]==============================*/
 
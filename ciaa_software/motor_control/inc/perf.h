@@ -0,0 +1,78 @@
+#ifndef __PERF_H_
+#define __PERF_H_
+
+ /** \addtogroup MotorControl
+ ** @{ */
+
+/** \brief Medición del costo de las secciones que recorren todos los motores.
+ *
+ * Cada sección se mide con marcas de tiempo en ciclos de reloj (\see timestamp.h),
+ * acumulando la cantidad de ejecuciones, el total y el máximo. Permite verificar
+ * cuánto crece el tiempo de cada período al aumentar \p BOARD_MOTOR_COUNT.
+ *
+ \verbatim
+    uint32_t inicio = perf_begin();
+    ...
+    perf_end(PERF_PWM_UPDATE, inicio);
+ \endverbatim
+ *
+ */
+
+ /** \defgroup Perf Perf
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+
+#include "ciaaPOSIX_stdio.h"  /* <= device handler header */
+#include "timestamp.h"
+
+/*==================[macros]=================================================*/
+
+/** \brief Marca el comienzo de una sección, devuelve la marca de tiempo a pasarle a \p perf_end(). */
+#define perf_begin()			timestamp_now()
+
+/*==================[typedef]================================================*/
+
+/** \brief Secciones medidas. */
+typedef enum {
+	PERF_ENCODER_TASK = 0,	/**< Muestreo de todos los encoders en EncoderTask, sin el callback */
+	PERF_PWM_UPDATE,		/**< Actualización de las salidas PWM de todos los motores */
+	PERF_TELEMETRY,			/**< Armado y envío de la telemetría de todos los encoders */
+	PERF_OBSERVER,			/**< Actualización del observador de velocidad de todos los encoders */
+	PERF_SPEED_CONTROL,		/**< Ejecución del control de velocidad de todos los motores */
+	PERF_TRAJECTORY,		/**< Un paso del generador de trayectorias de un motor, \see trajectory.h */
+	PERF_SECTION_COUNT
+} PerfSection;
+
+
+/** \brief Estadísticas de una sección, en ciclos de reloj. */
+typedef struct {
+	uint32_t	count; /**< Cantidad de ejecuciones medidas. */
+	uint32_t	averageCycles;
+	uint32_t	maxCycles;
+} PerfStats;
+
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+
+/** \brief Registra una ejecución de una sección.
+ *
+ * \param[in] section Sección medida.
+ * \param[in] start Valor devuelto por \p perf_begin() al comenzar la sección.
+ *
+ */
+extern void perf_end(PerfSection section, uint32_t start);
+
+
+/** \brief Obtiene las estadísticas de una sección. */
+extern void perf_getStats(PerfSection section, PerfStats * stats);
+
+
+/** \brief Descarta las mediciones de todas las secciones. */
+extern void perf_reset(void);
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+
+#endif /* __PERF_H_ */
@@ -6,8 +6,30 @@
 
 /** \brief Maneja las salidas PWM.
  *
- * Administra los distintos dispositivos PWM. En total se utilizan cuatro, dos
- * por motor, cada uno de éstos para desplazarse en un sentido distinto.
+ * Administra los distintos dispositivos PWM. Se utilizan dos por motor, cada
+ * uno de éstos para desplazarse en un sentido distinto, según la descripción
+ * de la placa (\see board.h).
+ *
+ * Con \p BOARD_PWM_DIRECT el módulo configura el SCT y cada actualización
+ * escribe directamente el registro de recarga del match de cada señal, que el
+ * SCT toma al comenzar el período siguiente. Durante cada actualización la recarga
+ * está deshabilitada (NORELOAD), por lo que todas las señales de todos los
+ * motores cambian juntas en el mismo límite de período: un cambio de sentido
+ * no deja una ventana con ambas ramas del puente activas ni pulsos parciales.
+ * Cada actualización toma el resource PWMR de OSEK, por lo que una tarea de
+ * mayor prioridad no puede escribir las salidas en medio de otra; toda tarea
+ * que las escriba debe declararlo en el OIL.
+ * El ciclo de trabajo tiene 16 bits
+ * (\see ciaaPWM_writeMotors()); la resolución efectiva es la cantidad de ciclos
+ * de reloj del período, 204000 a 1 kHz. Sin \p BOARD_PWM_DIRECT se usan los
+ * dispositivos del driver POSIX y el ciclo de trabajo se redondea a %.
+ *
+ * La frecuencia y el tiempo muerto de cada señal se cambian en ejecución
+ * (\see ciaaPWM_setFrequency()). El tiempo muerto retrasa la activación de la
+ * señal al comienzo de cada período, con un segundo registro de match, de modo
+ * que al invertir el sentido de un motor ambas ramas del puente quedan
+ * apagadas al menos ese tiempo.
+ *
  * Expone la posibilidad de modificar el ciclo de trabajo de las señales, a
  * partir del número de motor, la dirección del movimiento y el valor del ciclo
  * de trabajo en sí.
@@ -38,6 +60,19 @@
 /** \brief Valor de ciclo de trabajo establecido para cada salida PWM al inicializar el módulo. */
 #define MIN_DUTY_CYCLE		(0)
 
+/** \brief Rango de frecuencias de las señales PWM configurables con \p ciaaPWM_setFrequency(), en Hz. */
+#define PWM_MIN_FREQUENCY_HZ	(50)
+#define PWM_MAX_FREQUENCY_HZ	(100000)
+
+/** \brief Ciclo de trabajo de 100 % en \p MotorPwmData. */
+#define PWM_DUTY_MAX		(0xFFFF)
+
+/** \brief Convierte un ciclo de trabajo en % (0 a 100) a 16 bits. */
+#define ciaaPWM_percentToDuty(percent)	((uint16_t)(((uint32_t)(percent) * PWM_DUTY_MAX + 50) / 100))
+
+/** \brief Convierte un ciclo de trabajo de 16 bits a % redondeado. */
+#define ciaaPWM_dutyToPercent(duty)		((uint8_t)(((uint32_t)(duty) * 100 + PWM_DUTY_MAX / 2) / PWM_DUTY_MAX))
+
 /*==================[typedef]================================================*/
 
 /** \brief Sentido de movimiento del motor. */
@@ -56,6 +91,22 @@ typedef struct {
 	MotorDirection	direction;
 } MotorControlData;
 
+
+/** \brief Estado de un motor con el ciclo de trabajo en 16 bits. */
+typedef struct {
+	uint8_t			motorID;
+	uint16_t		duty; /**< De 0 a \p PWM_DUTY_MAX. */
+	MotorDirection	direction;
+} MotorPwmData;
+
+
+
+/** \brief Escrituras de las salidas PWM desde el inicio. */
+typedef struct {
+	uint32_t	writes; /**< Señales escritas. */
+	uint32_t	savedWrites; /**< Señales no escritas porque su motor ya tenía el estado pedido. */
+} PwmWriteStats;
+
 /*==================[external data declaration]==============================*/
 
 /*==================[external functions declaration]=========================*/
@@ -86,6 +137,94 @@ extern void ciaaPWM_init(void);
  */
 extern void ciaaPWM_updateMotor(MotorControlData data);
 
+
+/** \brief Actualiza el estado de varios motores a la vez.
+ *
+ * Primero se calcula el valor de todas las señales PWM involucradas y luego
+ * se escriben en una única pasada, de manera que todos los motores cambien
+ * en el mismo período de la señal PWM. En cada señal se escribe primero la
+ * que debe deshabilitarse, igual que en \p ciaaPWM_updateMotor().
+ *
+ * Los elementos con un identificador de motor inválido se ignoran, y los de un
+ * motor que ya tiene el estado pedido no escriben sus señales (\see ciaaPWM_getWriteStats()).
+ *
+ * \param[in] data Arreglo con el estado buscado para cada motor.
+ * \param[in] count Cantidad de elementos de \p data.
+ *
+ */
+extern void ciaaPWM_updateMotors(const MotorControlData * data, uint8_t count);
+
+
+/** \brief Actualiza el estado de varios motores a la vez, con ciclos de trabajo de 16 bits.
+ *
+ * Es la implementación de \p ciaaPWM_updateMotors(), que convierte los % y la llama.
+ *
+ * \param[in] data Arreglo con el estado buscado para cada motor.
+ * \param[in] count Cantidad de elementos de \p data.
+ *
+ */
+extern void ciaaPWM_writeMotors(const MotorPwmData * data, uint8_t count);
+
+
+/** \brief Obtiene el último estado aplicado a un motor.
+ *
+ * \param[in] motorID Número de motor.
+ * \return Ciclo de trabajo y sentido aplicados, ciclo de trabajo 0 si el motor es inválido.
+ *
+ */
+extern MotorControlData ciaaPWM_getMotor(uint8_t motorID);
+
+
+/** \brief Obtiene la cantidad de escrituras de las salidas PWM, y las ahorradas. */
+extern void ciaaPWM_getWriteStats(PwmWriteStats * stats);
+
+
+/** \brief Cambia la frecuencia de las señales PWM.
+ *
+ * Sólo con \p BOARD_PWM_DIRECT. Se aplica en \p ciaaPWM_applyConfig(), con los
+ * ciclos de trabajo de los motores reescalados al nuevo período.
+ *
+ * \param[in] frequencyHz Frecuencia, de \p PWM_MIN_FREQUENCY_HZ a \p PWM_MAX_FREQUENCY_HZ.
+ * \return Si es negativo, la frecuencia era inválida o dejaba el tiempo muerto de alguna señal en más de medio período.
+ *
+ */
+extern int32_t ciaaPWM_setFrequency(uint32_t frequencyHz);
+
+
+/** \brief Obtiene la frecuencia configurada en Hz, 0 si la fija el driver POSIX. */
+extern uint32_t ciaaPWM_getFrequency(void);
+
+
+/** \brief Obtiene la cantidad de pasos del ciclo de trabajo en un período: ciclos de reloj del SCT, o 100 con el driver POSIX. */
+extern uint32_t ciaaPWM_getResolution(void);
+
+
+/** \brief Cambia el tiempo muerto de una señal.
+ *
+ * Sólo con \p BOARD_PWM_DIRECT y hasta 7 señales, que dejan un registro de
+ * match libre para cada una. Se aplica en \p ciaaPWM_applyConfig().
+ *
+ * \param[in] channel Número de señal, índice en \p boardPwmChannels.
+ * \param[in] deadTimeNS Tiempo muerto en ns, a lo sumo medio período.
+ * \return Si es negativo, la señal o el tiempo eran inválidos.
+ *
+ */
+extern int32_t ciaaPWM_setDeadTime(uint8_t channel, uint16_t deadTimeNS);
+
+
+/** \brief Obtiene el tiempo muerto configurado de una señal, en ns. */
+extern uint16_t ciaaPWM_getDeadTime(uint8_t channel);
+
+
+/** \brief Aplica la frecuencia y los tiempos muertos pedidos, si cambiaron.
+ *
+ * Debe llamarse desde EncoderTask en cada período de muestreo, antes del
+ * control de velocidad, \see encoder_setSampleCallback(). El SCT se detiene
+ * mientras se reconfigura y comienza un período nuevo.
+ *
+ */
+extern void ciaaPWM_applyConfig(void);
+
 /** @} doxygen end group definition */
 /** @} doxygen end group definition */
 
@@ -0,0 +1,135 @@
+#ifndef __SCRIPT_H_
+#define __SCRIPT_H_
+
+ /** \addtogroup MotorControl
+ ** @{ */
+
+/** \brief Intérprete de guiones de movimiento, ejecutados en la placa.
+ *
+ * Un guion es una secuencia de instrucciones en bytecode que el cliente carga
+ * en RAM (\see script_load()) y luego ejecuta con \p script_start(). El
+ * intérprete corre desde EncoderTask en cada período de muestreo, antes del
+ * control de velocidad, por lo que los tiempos no dependen del enlace WiFi:
+ * las esperas se cuentan en muestras y cada consigna se aplica en la misma
+ * muestra en que se ejecuta su instrucción.
+ *
+ * Cada instrucción es un código de operación de un byte seguido de sus
+ * argumentos, little-endian:
+ *
+ \verbatim
+  Código  Instrucción   Argumentos
+  0x00    FIN           -
+  0x01    CICLO         motor (u8), ciclo de trabajo (i8, -100 a 100)
+  0x02    VELOCIDAD     motor (u8), RPM (i16)
+  0x03    RAMPA         motor (u8), aceleración (u16), jerk (u16)
+  0x04    ESPERAR       tiempo en ms (u16)
+  0x05    DISTANCIA     encoder (u8), flancos (u32), tiempo máximo en ms (u16, 0 sin límite)
+  0x06    DETENER       -
+ \endverbatim
+ *
+ * - CICLO, VELOCIDAD y RAMPA equivalen a \p speedControl_setDutyCycle(),
+ *   \p speedControl_setSetpoint() y \p speedControl_setLimits().
+ * - DISTANCIA espera a que el encoder se desplace la cantidad de flancos
+ *   indicada, en cualquier sentido, desde que comienza la instrucción. Si pasa
+ *   el tiempo máximo el guion termina con error y los motores se detienen.
+ * - DETENER pone el ciclo de trabajo de todos los motores en 0.
+ *
+ * Las instrucciones que no esperan se ejecutan en la misma muestra, hasta
+ * \p SCRIPT_MAX_STEPS por muestra. Al cargarlo, el guion se verifica completo:
+ * códigos válidos, argumentos dentro del guion y una instrucción FIN.
+ *
+ */
+
+ /** \defgroup Script Script
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+
+#include "ciaaPOSIX_stdio.h"  /* <= device handler header */
+
+/*==================[macros]=================================================*/
+
+/** \brief Tamaño máximo de un guion, en bytes. */
+#define SCRIPT_MAX_LENGTH		(256)
+
+/** \brief Máxima cantidad de instrucciones ejecutadas en una muestra. */
+#define SCRIPT_MAX_STEPS		(16)
+
+/*==================[typedef]================================================*/
+
+/** \brief Códigos de operación. */
+typedef enum {
+	SCRIPT_OP_END = 0x00,
+	SCRIPT_OP_DUTY = 0x01,
+	SCRIPT_OP_SPEED = 0x02,
+	SCRIPT_OP_RAMP = 0x03,
+	SCRIPT_OP_WAIT = 0x04,
+	SCRIPT_OP_DISTANCE = 0x05,
+	SCRIPT_OP_STOP = 0x06,
+	SCRIPT_OP_COUNT
+} ScriptOpcode;
+
+
+/** \brief Estado del intérprete. */
+typedef enum {
+	SCRIPT_STATE_IDLE = 0,		/**< Sin ejecutar desde la última carga. */
+	SCRIPT_STATE_RUNNING,		/**< Ejecutando. */
+	SCRIPT_STATE_DONE,			/**< Llegó a FIN. */
+	SCRIPT_STATE_ABORTED,		/**< Detenido con \p script_abort(). */
+	SCRIPT_STATE_ERROR			/**< Instrucción inválida o tiempo máximo de DISTANCIA agotado. */
+} ScriptState;
+
+
+/** \brief Estado del intérprete y posición en el guion. */
+typedef struct {
+	uint8_t		state; /**< \see ScriptState */
+	uint16_t	pc; /**< Byte de la instrucción en curso o de la última ejecutada. */
+	uint16_t	length; /**< Bytes cargados. */
+	uint32_t	samples; /**< Muestras transcurridas desde el inicio. */
+} ScriptStatus;
+
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+
+/** \brief Carga parte de un guion.
+ *
+ * Un guion largo se carga por partes; la de \p offset 0 descarta el anterior.
+ * No puede cargarse mientras se ejecuta.
+ *
+ * \param[in] offset Posición en el guion de los datos.
+ * \param[in] data Bytecode.
+ * \param[in] length Cantidad de bytes.
+ * \return Si es negativo, se estaba ejecutando o los datos no entraban.
+ *
+ */
+extern int32_t script_load(uint16_t offset, const uint8_t * data, uint16_t length);
+
+
+/** \brief Verifica el guion cargado y comienza a ejecutarlo desde el principio.
+ *
+ * \return Si es negativo, el guion era inválido o ya se estaba ejecutando.
+ *
+ */
+extern int32_t script_start(void);
+
+
+/** \brief Detiene la ejecución del guion. Los motores quedan con sus últimas consignas. */
+extern void script_abort(void);
+
+
+/** \brief Ejecuta las instrucciones que correspondan a esta muestra.
+ *
+ * Debe llamarse desde EncoderTask en cada período de muestreo, \see encoder_setSampleCallback().
+ *
+ */
+extern void script_update(void);
+
+
+/** \brief Obtiene el estado del intérprete. */
+extern void script_getStatus(ScriptStatus * status);
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+
+#endif /* __SCRIPT_H_ */
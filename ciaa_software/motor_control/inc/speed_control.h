@@ -0,0 +1,238 @@
+#ifndef __SPEED_CONTROL_H_
+#define __SPEED_CONTROL_H_
+
+ /** \addtogroup MotorControl
+ ** @{ */
+
+/** \brief Control de velocidad a lazo cerrado, con un PID en punto fijo por motor, y
+ * rampas de ciclo de trabajo a lazo abierto.
+ *
+ * Se ejecuta desde EncoderTask cada \p speedControl_setDivider() muestras de los
+ * encoders, por lo que su período es un múltiplo del período de muestreo y no
+ * depende de las tareas de menor prioridad. La velocidad medida es la del
+ * observador (\see SPEED_TYPE_OBSERVED), y el encoder de cada motor es el de su
+ * mismo número.
+ *
+ * - La derivada se calcula sobre la velocidad medida, por lo que un cambio de
+ *   consigna no produce un salto en la salida.
+ * - La salida se limita a +/-100 % de ciclo de trabajo; su signo es el sentido
+ *   de giro, y se informa a los encoders de un único canal.
+ * - Anti-windup: el integrador no se actualiza mientras la salida está saturada
+ *   en el mismo sentido que el error, y se limita a +/-100 %.
+ * - Con consigna 0 la salida es 0 y el integrador se reinicia.
+ *
+ * Las salidas de todos los motores controlados se aplican con una única
+ * llamada a \p ciaaPWM_updateMotors(). Un comando de ciclo de trabajo para un
+ * motor le deshabilita el control (\see speedControl_disable()), salvo que tenga
+ * límites de aceleración: en ese caso se lo pasa a \p speedControl_setDutyCycle().
+ *
+ * Límites de aceleración y jerk: con \p speedControl_setLimits() cada consigna
+ * nueva, de velocidad o de ciclo de trabajo (\see speedControl_setDutyCycle()),
+ * se alcanza con una trayectoria trapezoidal o en S (\see trajectory.h) que
+ * avanza un paso por ejecución del control. Al cambiar de modo la trayectoria
+ * parte de la velocidad medida o del ciclo de trabajo aplicado, sin saltos. Las
+ * consignas se escriben desde otras tareas y EncoderTask las toma en su próxima
+ * ejecución. El costo de cada paso se mide como \p PERF_TRAJECTORY.
+ *
+ * Prealimentación: cada caracterización completa de un motor (\see
+ * speedControl_recordCharacterization()) guarda su curva velocidad-ciclo de
+ * trabajo en una tabla de \p SPEED_CONTROL_FF_POINTS puntos. El control la usa
+ * en forma inversa, interpolando el ciclo de trabajo que corresponde a la
+ * consigna, y el PID sólo corrige la diferencia; así la salida alcanza su valor
+ * final en la primera ejecución luego del cambio de consigna. La curva se mide
+ * hacia adelante y se usa, con signo opuesto, también hacia atrás.
+ *
+ * Se mide también la variación del período real de ejecución respecto del
+ * nominal (jitter), con las marcas de tiempo de \p timestamp_now().
+ *
+ */
+
+ /** \defgroup SpeedControl Speed Control
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+
+#include "ciaaPOSIX_stdio.h"  /* <= device handler header */
+
+/*==================[macros]=================================================*/
+
+/** \brief Ganancias iniciales, en milésimas. \see speedControl_setGains() */
+#define SPEED_CONTROL_DEFAULT_KP		(50)
+#define SPEED_CONTROL_DEFAULT_KI		(500)
+#define SPEED_CONTROL_DEFAULT_KD		(0)
+
+/** \brief Separación, en % de ciclo de trabajo, entre los puntos de la tabla de prealimentación. */
+#define SPEED_CONTROL_FF_STEP			(5)
+
+/** \brief Cantidad de puntos de la tabla de prealimentación, de 0 a 100 %. */
+#define SPEED_CONTROL_FF_POINTS			(100 / SPEED_CONTROL_FF_STEP + 1)
+
+/** \brief Período de ejecución máximo del control, en ms. \see speedControl_setDivider() */
+#define SPEED_CONTROL_MAX_PERIOD_MS		(65535)
+
+/** \brief Velocidad deseada máxima, en RPM, la misma que admite un guion. \see speedControl_setSetpoint() */
+#define SPEED_CONTROL_MAX_RPM			(32767)
+
+/*==================[typedef]================================================*/
+
+/** \brief Estadísticas del período de ejecución del control. */
+typedef struct {
+	uint16_t	periodMS; /**< Período nominal. */
+	uint32_t	count; /**< Períodos medidos. */
+	uint32_t	averageJitterUS; /**< Promedio de la diferencia absoluta entre el período real y el nominal. */
+	uint32_t	maxJitterUS;
+} SpeedControlTiming;
+
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+
+/** \brief Configuración inicial del módulo, con el control de todos los motores deshabilitado. */
+extern void speedControl_init(void);
+
+
+/** \brief Ejecuta el control si corresponde a esta muestra.
+ *
+ * Debe llamarse desde EncoderTask en cada período de muestreo, \see encoder_setSampleCallback().
+ *
+ */
+extern void speedControl_update(void);
+
+
+/** \brief Fija la velocidad deseada de un motor y le habilita el control.
+ *
+ * \param[in] motorID Número de motor.
+ * \param[in] rpm Velocidad deseada en RPM, el signo indica el sentido, hasta \p SPEED_CONTROL_MAX_RPM.
+ * \return Si es negativo, el motor o la velocidad eran inválidos.
+ *
+ */
+extern int32_t speedControl_setSetpoint(uint8_t motorID, int32_t rpm);
+
+
+/** \brief Fija la velocidad deseada de varios motores a la vez y les habilita el control.
+ *
+ * EncoderTask toma todas las consignas en la misma ejecución del control.
+ *
+ * \param[in] motorIDs Número de cada motor.
+ * \param[in] speeds Velocidad deseada de cada motor en décimas de RPM, el signo indica el sentido.
+ * \param[in] count Cantidad de motores.
+ * \return Si es negativo, algún motor era inválido y no se fijó ninguna consigna.
+ *
+ */
+extern int32_t speedControl_setSetpoints(const uint8_t * motorIDs, const int32_t * speeds, uint8_t count);
+
+
+/** \brief Fija el ciclo de trabajo de un motor a lazo abierto, alcanzado con los límites de \p speedControl_setLimits().
+ *
+ * \param[in] motorID Número de motor.
+ * \param[in] dutyCycle Ciclo de trabajo de -100 a 100 %, el signo indica el sentido.
+ * \return Si es negativo, el motor o el ciclo de trabajo eran inválidos.
+ *
+ */
+extern int32_t speedControl_setDutyCycle(uint8_t motorID, int8_t dutyCycle);
+
+
+/** \brief Fija el ciclo de trabajo de varios motores a la vez, como \p speedControl_setDutyCycle().
+ *
+ * EncoderTask toma todas las consignas en la misma ejecución del control.
+ *
+ * \param[in] motorIDs Número de cada motor.
+ * \param[in] dutyCycles Ciclo de trabajo de cada motor, de -100 a 100 %.
+ * \param[in] count Cantidad de motores.
+ * \return Si es negativo, algún motor o ciclo de trabajo era inválido y no se fijó ninguna consigna.
+ *
+ */
+extern int32_t speedControl_setDutyCycles(const uint8_t * motorIDs, const int8_t * dutyCycles, uint8_t count);
+
+
+/** \brief Configura los límites de la trayectoria de las consignas de un motor.
+ *
+ * Las unidades son las de la consigna que se esté siguiendo: RPM o % de ciclo de trabajo.
+ *
+ * \param[in] motorID Número de motor.
+ * \param[in] accel Pendiente máxima por segundo. Con 0 las consignas se aplican de inmediato.
+ * \param[in] jerk Variación máxima de la pendiente por segundo al cuadrado. Con 0 el perfil es trapezoidal.
+ * \return Si es negativo, el motor era inválido.
+ *
+ */
+extern int32_t speedControl_setLimits(uint8_t motorID, uint16_t accel, uint16_t jerk);
+
+
+/** \brief Indica si un motor tiene límite de aceleración, y sus ciclos de trabajo deben pasar por \p speedControl_setDutyCycle(). */
+extern uint8_t speedControl_hasLimits(uint8_t motorID);
+
+
+/** \brief Deshabilita el control de un motor, su salida PWM queda con el último valor. */
+extern void speedControl_disable(uint8_t motorID);
+
+
+/** \brief Deshabilita el control de todos los motores. */
+extern void speedControl_disableAll(void);
+
+
+/** \brief Configura las ganancias del PID de un motor.
+ *
+ * \param[in] motorID Número de motor.
+ * \param[in] kp Milésimas de % de ciclo de trabajo por RPM de error.
+ * \param[in] ki Milésimas de % de ciclo de trabajo por RPM de error y por segundo.
+ * \param[in] kd Milésimas de % de ciclo de trabajo por RPM/s de variación de la velocidad.
+ * \return Si es negativo, el motor era inválido.
+ *
+ */
+extern int32_t speedControl_setGains(uint8_t motorID, uint16_t kp, uint16_t ki, uint16_t kd);
+
+
+/** \brief Configura cada cuántas muestras de los encoders se ejecuta el control.
+ *
+ * Reinicia las estadísticas del período de ejecución.
+ *
+ * \param[in] samples Cantidad de muestras, desde 1, sin que el período de ejecución supere
+ * \p SPEED_CONTROL_MAX_PERIOD_MS. Si un cambio posterior del período de muestreo lo supera,
+ * el control usa ese máximo para sus ganancias.
+ * \return Si es negativo, el valor era inválido.
+ *
+ */
+extern int32_t speedControl_setDivider(uint16_t samples);
+
+
+/** \brief Obtiene las estadísticas del período de ejecución del control. */
+extern void speedControl_getTiming(SpeedControlTiming * timing);
+
+
+/** \brief Registra un punto de la caracterización de un motor.
+ *
+ * Debe llamarse con los ciclos de trabajo en orden creciente desde 0; los que no
+ * son múltiplos de \p SPEED_CONTROL_FF_STEP se ignoran. Al registrar el de 100 %
+ * la curva reemplaza a la tabla de prealimentación del motor. Un barrido
+ * interrumpido o de otro motor no modifica ninguna tabla.
+ *
+ * \param[in] motorID Número de motor.
+ * \param[in] dutyCycle Ciclo de trabajo aplicado durante la medición.
+ * \param[in] speed Velocidad medida en décimas de RPM, se toma su valor absoluto.
+ *
+ */
+extern void speedControl_recordCharacterization(uint8_t motorID, uint8_t dutyCycle, int32_t speed);
+
+
+/** \brief Obtiene la tabla de prealimentación de un motor.
+ *
+ * \param[in] motorID Número de motor.
+ * \param[out] table Velocidad en décimas de RPM para cada punto, de al menos
+ * \p SPEED_CONTROL_FF_POINTS elementos.
+ * \return Cantidad de puntos, 0 si el motor no tiene una tabla.
+ *
+ */
+extern uint8_t speedControl_getFeedForward(uint8_t motorID, uint16_t * table);
+
+
+/** \brief Descarta la tabla de prealimentación de un motor, que queda controlado sólo por el PID.
+ *
+ * \return Si es negativo, el motor era inválido.
+ *
+ */
+extern int32_t speedControl_clearFeedForward(uint8_t motorID);
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+
+#endif /* __SPEED_CONTROL_H_ */
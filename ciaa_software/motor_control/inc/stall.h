@@ -0,0 +1,98 @@
+#ifndef __STALL_H_
+#define __STALL_H_
+
+ /** \addtogroup MotorControl
+ ** @{ */
+
+/** \brief Detección de motores atascados.
+ *
+ * En cada período de muestreo se compara el ciclo de trabajo aplicado a cada
+ * motor con el desplazamiento de su encoder: si durante la ventana configurada
+ * el ciclo de trabajo se mantuvo en al menos el mínimo y el encoder se movió
+ * menos de \p STALL_MIN_EDGES flancos, el motor está atascado. Su salida se
+ * corta en esa misma muestra, se detiene el guion en ejecución y se avisa con
+ * la función registrada en \p stall_setCallback().
+ *
+ * La reacción llega una ventana después del atasco, más un período de
+ * muestreo. Un comando nuevo vuelve a poner el motor en marcha; si sigue
+ * atascado se corta de nuevo tras otra ventana.
+ *
+ * La detección está habilitada desde el inicio para todos los motores, con la
+ * ventana de \p BOARD_STALL_WINDOW_MS, sin esperar a que un cliente la configure.
+ *
+ */
+
+ /** \defgroup Stall Stall
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+
+#include "ciaaPOSIX_stdio.h"  /* <= device handler header */
+
+/*==================[macros]=================================================*/
+
+/** \brief Flancos del encoder por ventana por debajo de los cuales el motor está atascado. */
+#define STALL_MIN_EDGES				(2)
+
+/** \brief Ciclo de trabajo mínimo inicial, en %, a partir del cual se vigila un motor. */
+#define STALL_DEFAULT_MIN_DUTY		(30)
+
+/*==================[typedef]================================================*/
+
+/** \brief Tipo de función llamada desde EncoderTask al cortar un motor atascado. */
+typedef void (*stallCallback_type)(uint8_t motorID);
+
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+
+/** \brief Inicializa el módulo, con la ventana de \p BOARD_STALL_WINDOW_MS para todos los motores. */
+extern void stall_init(void);
+
+
+/** \brief Configura la detección de un motor.
+ *
+ * \param[in] motorID Número de motor.
+ * \param[in] minDuty Ciclo de trabajo mínimo en % (1 a 100) a partir del cual se vigila el motor.
+ * \param[in] windowMS Ventana en ms, 0 deshabilita la detección.
+ * \return Si es negativo, algún parámetro era inválido.
+ *
+ */
+extern int32_t stall_configure(uint8_t motorID, uint8_t minDuty, uint16_t windowMS);
+
+
+/** \brief Obtiene la configuración de un motor y la cantidad de veces que se cortó por atascado.
+ *
+ * \param[in] motorID Número de motor.
+ * \param[out] minDuty Ciclo de trabajo mínimo en %.
+ * \param[out] windowMS Ventana en ms.
+ * \return Cantidad de atascos, o negativo si el motor era inválido.
+ *
+ */
+extern int32_t stall_getConfig(uint8_t motorID, uint8_t * minDuty, uint16_t * windowMS);
+
+
+/** \brief Suspende la detección, por ejemplo mientras se caracteriza un motor.
+ *
+ * \param[in] suspend 1 la suspende, 0 la reanuda con ventanas nuevas.
+ *
+ */
+extern void stall_suspend(uint8_t suspend);
+
+
+/** \brief Registra la función a llamar al cortar un motor atascado, o 0 para no llamar a ninguna. */
+extern void stall_setCallback(stallCallback_type fcnPtr);
+
+
+/** \brief Vigila los motores con la última muestra de los encoders.
+ *
+ * Debe llamarse desde EncoderTask en cada período de muestreo, antes del
+ * guion y del control de velocidad, \see encoder_setSampleCallback().
+ *
+ */
+extern void stall_update(void);
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+
+#endif /* __STALL_H_ */
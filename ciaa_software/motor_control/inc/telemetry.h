@@ -0,0 +1,114 @@
+#ifndef __TELEMETRY_H_
+#define __TELEMETRY_H_
+
+ /** \addtogroup MotorControl
+ ** @{ */
+
+/** \brief Distribuye los datos de telemetría a las conexiones suscriptas.
+ *
+ * Cada conexión puede suscribirse a uno o más streams de datos (por ejemplo,
+ * las velocidades de los encoders), eligiendo además cada cuántos períodos
+ * de conteo desea recibirlos.
+ *
+ * En cada período los datos se formatean una única vez, y luego se encolan
+ * para cada suscriptor que corresponda. Si una conexión tiene demasiados
+ * envíos pendientes, se descarta el dato para esa conexión en lugar de
+ * acumularlo, de manera que un suscriptor lento no demore a los demás, en
+ * especial a quien controla los motores.
+ *
+ */
+
+ /** \defgroup Telemetry Telemetry
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+
+#include "ciaaPOSIX_stdio.h"  /* <= device handler header */
+
+/*==================[macros]=================================================*/
+
+/** \brief Stream con la cantidad de interrupciones de cada encoder: "$SPEEDXTVALOR$". */
+#define TELEMETRY_STREAM_SPEED		(1 << 0)
+
+/** \brief Stream con la velocidad de cada encoder medida por tiempo entre flancos, en décimas
+ * de RPM con signo: "$SPEEDX2VALOR$". \see SPEED_TYPE_EDGE_TIMED */
+#define TELEMETRY_STREAM_EDGE_SPEED	(1 << 1)
+
+/** \brief Stream con la velocidad de cada encoder estimada por el observador, en décimas
+ * de RPM con signo: "$SPEEDX3VALOR$". \see SPEED_TYPE_OBSERVED */
+#define TELEMETRY_STREAM_OBSERVED_SPEED	(1 << 2)
+
+/** \brief Stream con la pose estimada por la odometría: "$POSE=X,Y,ORIENTACION$". \see odometry.h */
+#define TELEMETRY_STREAM_POSE		(1 << 3)
+
+/** \brief Máscara con todos los streams disponibles. */
+#define TELEMETRY_STREAM_ALL		(TELEMETRY_STREAM_SPEED | TELEMETRY_STREAM_EDGE_SPEED | \
+									 TELEMETRY_STREAM_OBSERVED_SPEED | TELEMETRY_STREAM_POSE)
+
+/** \brief Máxima cantidad de envíos pendientes de una conexión suscripta antes de descartar datos. */
+#define TELEMETRY_MAX_PENDING		(2)
+
+/*==================[typedef]================================================*/
+
+/** \brief Formato con el que se envían los datos a un suscriptor. */
+typedef enum {
+    TELEMETRY_FORMAT_ASCII = 0, /**< Mensajes "$...$" tal cual. */
+    TELEMETRY_FORMAT_SSE   = 1, /**< Cada envío es un evento Server-Sent Events ("data: ...\n\n"). */
+    TELEMETRY_FORMAT_BINARY = 2 /**< Cada stream es una trama del protocolo binario. \see binary_protocol.h */
+} TelemetryFormat;
+
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+
+/** \brief Inicializa el módulo, sin suscriptores. */
+extern void telemetry_init(void);
+
+
+/** \brief Suscribe una conexión a los streams indicados.
+ *
+ * Si la conexión ya estaba suscripta, se reemplaza su suscripción.
+ *
+ * \param[in] connectionID Conexión a suscribir.
+ * \param[in] streams Máscara de streams (\p TELEMETRY_STREAM_...). Si es 0, se elimina la suscripción.
+ * \param[in] rate Cantidad de períodos de conteo entre envíos, 1 significa todos los períodos.
+ * \param[in] format Formato de los envíos.
+ * \return Si es negativo, los parámetros eran inválidos.
+ *
+ */
+extern int32_t telemetry_subscribe(uint8_t connectionID, uint8_t streams, uint8_t rate, TelemetryFormat format);
+
+
+/** \brief Elimina la suscripción de una conexión, por ejemplo al cerrarse. */
+extern void telemetry_unsubscribe(uint8_t connectionID);
+
+
+/** \brief Establece el formato de los envíos a una conexión, sin modificar su suscripción.
+ *
+ * Es el formato con el que recibe las velocidades quien controla los motores,
+ * y el de su suscripción si la tiene. Al suscribirse, se reemplaza por el formato
+ * indicado en \p telemetry_subscribe().
+ *
+ */
+extern void telemetry_setFormat(uint8_t connectionID, TelemetryFormat format);
+
+
+/** \brief Formatea los datos del período y los envía a quien controla y a los suscriptores.
+ *
+ * Debe llamarse una vez por período de conteo de los encoders.
+ *
+ * \param[in] controllerID Conexión de quien controla los motores, o \p MAX_MULTIPLE_CONNECTIONS
+ * si no hay ninguna. Recibe las velocidades en todos los períodos, sin descartes, salvo que
+ * haya establecido su propia suscripción.
+ *
+ */
+extern void telemetry_publish(uint8_t controllerID);
+
+
+/** \brief Cantidad de envíos descartados para una conexión por tener demasiados envíos pendientes. */
+extern uint32_t telemetry_getDroppedFrames(uint8_t connectionID);
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+
+#endif /* __TELEMETRY_H_ */
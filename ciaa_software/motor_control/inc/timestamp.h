@@ -0,0 +1,50 @@
+#ifndef __TIMESTAMP_H_
+#define __TIMESTAMP_H_
+
+ /** \addtogroup MotorControl
+ ** @{ */
+
+/** \brief Marcas de tiempo de alta resolución.
+ *
+ * Usa el contador de ciclos del núcleo (DWT CYCCNT), que avanza una vez por
+ * ciclo de reloj y da la vuelta en 32 bits (unos 21 segundos a 204 MHz).
+ * Leerlo cuesta un único acceso a registro, por lo que puede usarse dentro
+ * de las interrupciones. La diferencia entre dos marcas es válida mientras
+ * no haya pasado más de una vuelta entre ambas.
+ *
+ */
+
+ /** \defgroup Timestamp Timestamp
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+
+#include "ciaaPOSIX_stdio.h"  /* <= device handler header */
+#include "chip.h"
+
+/*==================[macros]=================================================*/
+
+/** \brief Marca de tiempo actual, en ciclos de reloj. */
+#define timestamp_now()			(DWT->CYCCNT)
+
+/*==================[typedef]================================================*/
+
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+
+/** \brief Habilita el contador de ciclos. Debe llamarse antes de tomar marcas de tiempo. */
+extern void timestamp_init(void);
+
+
+/** \brief Cantidad de ciclos de reloj por microsegundo. */
+extern uint32_t timestamp_cyclesPerMicrosecond(void);
+
+
+/** \brief Convierte una diferencia de marcas de tiempo a microsegundos. */
+extern uint32_t timestamp_toMicroseconds(uint32_t cycles);
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+
+#endif /* __TIMESTAMP_H_ */
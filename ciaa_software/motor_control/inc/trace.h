@@ -0,0 +1,77 @@
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+ /** \addtogroup MotorControl
+ ** @{ */
+
+/** \brief Envía a una conexión la traza de flancos de los encoders.
+ *
+ * Mientras la traza está activa, las interrupciones de los encoders guardan el
+ * tiempo entre flancos en un buffer por encoder (\see encoder_setTraceMask()).
+ * Este módulo vacía esos buffers desde la tarea de menor prioridad, enviando
+ * varias entradas por mensaje, y sólo cuando la conexión no tiene envíos
+ * pendientes acumulados. Las entradas se quitan del buffer recién cuando su
+ * envío fue encolado, por lo que si el módulo WiFi no da abasto, la pérdida
+ * queda registrada en el contador de desbordes del encoder, que viaja en cada
+ * mensaje.
+ *
+ * Formatos de los mensajes, con los tiempos en ciclos de reloj y el bit 31 en 1
+ * para los flancos hacia atrás:
+ *
+ * - ASCII: "$TRAZA=ENCODER,DESBORDES,T1,T2,...$"
+ * - Binario: trama \p BINPROTO_MSG_TRAZA.
+ *
+ */
+
+ /** \defgroup Trace Trace
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+
+#include "ciaaPOSIX_stdio.h"  /* <= device handler header */
+
+/*==================[macros]=================================================*/
+
+/** \brief Máxima cantidad de envíos pendientes de la conexión para seguir enviando la traza. */
+#define TRACE_MAX_PENDING			(2)
+
+/*==================[typedef]================================================*/
+
+/** \brief Formato de los mensajes de traza. */
+typedef enum {
+    TRACE_FORMAT_ASCII  = 0,
+    TRACE_FORMAT_BINARY = 1
+} TraceFormat;
+
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+
+/** \brief Comienza a enviar la traza de los encoders indicados a una conexión.
+ *
+ * Si ya había una traza en curso, se reemplaza.
+ *
+ * \param[in] connectionID Conexión que recibe la traza.
+ * \param[in] encoderMask Máscara de encoders a trazar, distinta de 0.
+ * \param[in] format Formato de los mensajes.
+ * \return Si es negativo, los parámetros eran inválidos.
+ *
+ */
+extern int32_t trace_start(uint8_t connectionID, uint8_t encoderMask, TraceFormat format);
+
+
+/** \brief Detiene la traza en curso, si la hay. */
+extern void trace_stop(void);
+
+
+/** \brief Detiene la traza si la conexión que la recibía se cerró. */
+extern void trace_connectionClosed(uint8_t connectionID);
+
+
+/** \brief Envía las entradas acumuladas. Debe llamarse periódicamente desde una tarea de baja prioridad. */
+extern void trace_doWork(void);
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+
+#endif /* __TRACE_H_ */
@@ -0,0 +1,84 @@
+#ifndef __TRAJECTORY_H_
+#define __TRAJECTORY_H_
+
+ /** \addtogroup MotorControl
+ ** @{ */
+
+/** \brief Generador de trayectorias para consignas, con límites de pendiente y de jerk, en punto fijo.
+ *
+ * Lleva un valor (ciclo de trabajo, velocidad, etc.) desde su estado actual hasta
+ * el objetivo sin superar una pendiente máxima (aceleración, en unidades por
+ * segundo) ni una variación máxima de esa pendiente (jerk, en unidades por
+ * segundo al cuadrado):
+ *
+ * - Sin límite de jerk la pendiente cambia de inmediato y el perfil es trapezoidal.
+ * - Con límite de jerk la pendiente aumenta y disminuye gradualmente (curva S). La
+ *   pendiente buscada es la menor entre la máxima y sqrt(2 * jerk * distancia),
+ *   la que permite detenerse justo en el objetivo.
+ * - Si el objetivo cambia durante el recorrido, la pendiente actual se conserva
+ *   y se corrige con las mismas reglas, sin saltos.
+ *
+ * El valor y la pendiente están en Q16 de 64 bits, para conservar pendientes de
+ * fracciones de unidad por período. Las unidades son las del usuario.
+ *
+ */
+
+ /** \defgroup Trajectory Trajectory
+ ** @{ */
+
+/*==================[inclusions]=============================================*/
+
+#include "ciaaPOSIX_stdio.h"  /* <= device handler header */
+
+/*==================[macros]=================================================*/
+
+/** \brief Bits fraccionarios del valor y de la pendiente. */
+#define TRAJECTORY_Q_BITS		(16)
+
+/*==================[typedef]================================================*/
+
+/** \brief Estado y límites de una trayectoria. */
+typedef struct {
+	int64_t		value; /**< Valor actual, Q16 unidades. */
+	int64_t		rate; /**< Pendiente actual, Q16 unidades por segundo. */
+	int64_t		target; /**< Objetivo, Q16 unidades. */
+	uint32_t	accel; /**< Pendiente máxima en unidades por segundo, 0 sin límite. */
+	uint32_t	jerk; /**< Variación máxima de la pendiente en unidades por segundo al cuadrado, 0 sin límite. */
+} Trajectory;
+
+/*==================[external data declaration]==============================*/
+
+/*==================[external functions declaration]=========================*/
+
+/** \brief Ubica la trayectoria en un valor, detenida y con ese valor como objetivo. */
+extern void trajectory_reset(Trajectory * trajectory, int32_t value);
+
+
+/** \brief Configura los límites de la trayectoria.
+ *
+ * \param[inout] trajectory Trayectoria.
+ * \param[in] accel Pendiente máxima en unidades por segundo. Con 0 el valor salta al objetivo.
+ * \param[in] jerk Variación máxima de la pendiente en unidades por segundo al cuadrado.
+ * Con 0 el perfil es trapezoidal.
+ *
+ */
+extern void trajectory_setLimits(Trajectory * trajectory, uint32_t accel, uint32_t jerk);
+
+
+/** \brief Fija un nuevo objetivo, al que se llega en las próximas llamadas a \p trajectory_step(). */
+extern void trajectory_setTarget(Trajectory * trajectory, int32_t target);
+
+
+/** \brief Avanza la trayectoria un período.
+ *
+ * \param[inout] trajectory Trayectoria.
+ * \param[in] periodMS Tiempo transcurrido desde el paso anterior, en milisegundos.
+ * \return Nuevo valor, redondeado a unidades.
+ *
+ */
+extern int32_t trajectory_step(Trajectory * trajectory, uint16_t periodMS);
+
+/** @} doxygen end group definition */
+/** @} doxygen end group definition */
+
+#endif /* __TRAJECTORY_H_ */
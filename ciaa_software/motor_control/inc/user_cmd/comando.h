@@ -0,0 +1,63 @@
+#ifndef _COMANDO_H_
+#define _COMANDO_H_
+
+/*==================[inclusions]=============================================*/
+
+#include "../parser.h"
+
+/*==================[macros]=================================================*/
+
+#undef PARSER_DATA_T
+#undef PARSER_RESULTS_T
+
+#define PARSER_DATA_T				PARSER_DATA_TYPE(comando)
+#define PARSER_RESULTS_T			PARSER_RESULTS_TYPE(comando)
+#define PARSER_RESULTS_COMANDO_T	PARSER_RESULTS_TYPE(comando)
+
+#define INITIALIZER_COMANDO {USER_COMANDO, STATUS_UNINITIALIZED, 0, 0, &FUNCTIONS_USER_COMANDO}
+
+/** \brief Máxima cantidad de caracteres del nombre de un comando. */
+#define COMANDO_MAX_NAME_LENGTH		(24)
+
+/** \brief Máxima cantidad de argumentos numéricos de un comando. */
+#define COMANDO_MAX_ARGS			(8)
+
+/*==================[typedef]================================================*/
+
+typedef struct {
+    fsmStatus				state;
+    uint8_t					nameLength;
+    char					name[COMANDO_MAX_NAME_LENGTH + 1];
+    uint8_t					negative;
+    uint8_t					hasDigits;
+    const char * const *	commands;
+    uint8_t					commandCount;
+} PARSER_DATA_T;
+
+typedef struct {
+    uint8_t		commandIndex; /**< Posición del comando en la tabla registrada con \p comandoParser_setCommands(). */
+    uint8_t		argCount; /**< Cantidad de argumentos recibidos. */
+    int32_t		args[COMANDO_MAX_ARGS]; /**< Argumentos, en el orden en que fueron recibidos. */
+} PARSER_RESULTS_T;
+
+/*==================[external data declaration]==============================*/
+
+extern const ParserFunctions FUNCTIONS_USER_COMANDO;
+
+/*==================[external functions declaration]=========================*/
+
+/** \brief Establece la tabla de comandos que reconocerá el parser.
+ *
+ * El parser reconoce mensajes con el formato "$NOMBRE$" o "$NOMBRE=ARG1,ARG2,...$",
+ * donde NOMBRE debe ser alguno de los de la tabla y cada argumento es un entero
+ * decimal, opcionalmente precedido por '-'.
+ *
+ * \param[in] parserPtr Parser ya inicializado.
+ * \param[in] commands Tabla con los nombres de los comandos. Debe permanecer válida
+ * mientras se use el parser.
+ * \param[in] count Cantidad de elementos de la tabla.
+ *
+ */
+extern void comandoParser_setCommands(Parser* parserPtr, const char * const * commands, uint8_t count);
+
+#endif // _COMANDO_H_
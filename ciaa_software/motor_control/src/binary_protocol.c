@@ -0,0 +1,208 @@
+/*==================[inclusions]=============================================*/
+
+#include "binary_protocol.h"
+#include "ciaaPOSIX_string.h" /* <= string header */
+
+/*==================[macros and definitions]=================================*/
+
+/** \brief Posición de cada campo dentro de la trama. */
+#define POS_TYPE		(1)
+#define POS_LENGTH		(2)
+#define POS_PAYLOAD		(3)
+
+/** \brief Cantidad de bytes de la trama anteriores a los datos. */
+#define HEADER_LENGTH	(POS_PAYLOAD)
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+static uint16_t checkFrame(const uint8_t * frame, uint16_t available);
+
+/*==================[internal data definition]===============================*/
+
+/** \brief Tabla de CRC-16/CCITT por nibble, compromiso entre velocidad y memoria (32 bytes). */
+static const uint16_t crcTable[16] = {
+		0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+		0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+/** \brief Verifica una trama que comienza con el byte de sincronismo.
+ *
+ * \param[in] frame Comienzo de la trama.
+ * \param[in] available Cantidad de bytes disponibles a partir de \p frame.
+ * \return Longitud de la trama si está completa y su CRC es válido, 0 si todavía
+ * no está completa, o 1 si no es una trama válida (se descarta el sincronismo).
+ *
+ */
+static uint16_t checkFrame(const uint8_t * frame, uint16_t available)
+{
+	uint16_t frameLength;
+	uint16_t crc;
+
+	if (available < HEADER_LENGTH)
+	{
+		return 0;
+	}
+
+	if (frame[POS_LENGTH] > BINPROTO_MAX_PAYLOAD)
+	{
+		return 1;
+	}
+
+	frameLength = frame[POS_LENGTH] + BINPROTO_OVERHEAD;
+
+	if (available < frameLength)
+	{
+		return 0;
+	}
+
+	crc = binproto_crc16(0xFFFF, &frame[POS_TYPE], frame[POS_LENGTH] + 2);
+
+	if (crc != binproto_getU16(&frame[frameLength - 2]))
+	{
+		return 1;
+	}
+
+	return frameLength;
+}
+
+/*==================[external functions definition]==========================*/
+
+extern uint16_t binproto_crc16(uint16_t crc, const uint8_t * data, uint16_t length)
+{
+	while (length-- > 0)
+	{
+		crc = (crc << 4) ^ crcTable[(crc >> 12) ^ (*data >> 4)];
+		crc = (crc << 4) ^ crcTable[(crc >> 12) ^ (*data & 0x0F)];
+		data++;
+	}
+
+	return crc;
+}
+
+
+extern void binproto_initDecoder(BinprotoDecoder * decoder)
+{
+	decoder->count = 0;
+	decoder->crcErrors = 0;
+}
+
+
+extern void binproto_decode(BinprotoDecoder * decoder, const uint8_t * data, uint16_t length,
+                            binprotoFrameHandler_type handler, uint8_t connectionID)
+{
+	BinprotoFrame frame;
+	uint16_t pos = 0;
+	uint16_t needed;
+	uint16_t ret;
+
+	/* Si quedó una trama partida del mensaje anterior, se completa primero en el buffer */
+	while (decoder->count > 0 && pos < length)
+	{
+		/* Sólo se copia lo necesario para conocer la longitud, y luego el resto de la trama */
+		needed = (decoder->count < HEADER_LENGTH ? HEADER_LENGTH :
+				decoder->buffer[POS_LENGTH] + BINPROTO_OVERHEAD) - decoder->count;
+
+		if (decoder->count >= HEADER_LENGTH && decoder->buffer[POS_LENGTH] > BINPROTO_MAX_PAYLOAD)
+		{
+			needed = 0;
+		}
+
+		if (needed > length - pos)
+		{
+			needed = length - pos;
+		}
+
+		ciaaPOSIX_memcpy(&decoder->buffer[decoder->count], &data[pos], needed);
+		decoder->count += needed;
+		pos += needed;
+
+		ret = checkFrame(decoder->buffer, decoder->count);
+
+		if (ret > 1)
+		{
+			frame.type = decoder->buffer[POS_TYPE];
+			frame.length = decoder->buffer[POS_LENGTH];
+			frame.payload = &decoder->buffer[POS_PAYLOAD];
+			handler(&frame, connectionID);
+			decoder->count = 0;
+		}
+		else if (ret == 1)
+		{
+			/* Trama inválida: se retoma la búsqueda de sincronismo en los datos nuevos */
+			decoder->crcErrors++;
+			decoder->count = 0;
+		}
+	}
+
+	/* Camino rápido: las tramas completas se validan y entregan sin copiarlas */
+	while (pos < length)
+	{
+		if (data[pos] != BINPROTO_SYNC)
+		{
+			pos++;
+			continue;
+		}
+
+		ret = checkFrame(&data[pos], length - pos);
+
+		if (ret > 1)
+		{
+			frame.type = data[pos + POS_TYPE];
+			frame.length = data[pos + POS_LENGTH];
+			frame.payload = &data[pos + POS_PAYLOAD];
+			handler(&frame, connectionID);
+			pos += ret;
+		}
+		else if (ret == 1)
+		{
+			decoder->crcErrors++;
+			pos++;
+		}
+		else
+		{
+			/* La trama continúa en el próximo mensaje */
+			decoder->count = length - pos;
+			ciaaPOSIX_memcpy(decoder->buffer, &data[pos], decoder->count);
+			pos = length;
+		}
+	}
+}
+
+
+extern uint16_t binproto_encodeInPlace(uint8_t type, uint8_t length, uint8_t * frame)
+{
+	uint16_t crc;
+
+	frame[0] = BINPROTO_SYNC;
+	frame[POS_TYPE] = type;
+	frame[POS_LENGTH] = length;
+
+	crc = binproto_crc16(0xFFFF, &frame[POS_TYPE], length + 2);
+	binproto_putU16(&frame[POS_PAYLOAD + length], crc);
+
+	return length + BINPROTO_OVERHEAD;
+}
+
+
+extern uint16_t binproto_encode(uint8_t type, const uint8_t * payload, uint8_t length, uint8_t * out)
+{
+	if (length > BINPROTO_MAX_PAYLOAD)
+	{
+		return 0;
+	}
+
+	if (payload != &out[POS_PAYLOAD])
+	{
+		ciaaPOSIX_memcpy(&out[POS_PAYLOAD], payload, length);
+	}
+
+	return binproto_encodeInPlace(type, length, out);
+}
+
+/*==================[end of file]============================================*/
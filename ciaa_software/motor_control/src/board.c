@@ -0,0 +1,101 @@
+/*==================[inclusions]=============================================*/
+
+#include "board.h"
+#include "pwm.h"
+#include "chip.h"
+
+/*==================[macros and definitions]=================================*/
+
+/* Están descriptas la EDU-CIAA con el puente H L293D de dos motores, y con un segundo
+   L293D para cuatro. Para otra plataforma, agregar aquí sus tablas para la cantidad de
+   motores elegida. */
+#if BOARD_MOTOR_COUNT != 2 && BOARD_MOTOR_COUNT != 4
+#error "No hay una descripción de la placa para BOARD_MOTOR_COUNT motores"
+#endif
+
+/* Las salidas del segundo puente sólo se manejan escribiendo el SCT directamente */
+#if BOARD_MOTOR_COUNT == 4 && !BOARD_PWM_DIRECT
+#error "La descripción de cuatro motores necesita BOARD_PWM_DIRECT"
+#endif
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+
+/*==================[external data definition]===============================*/
+
+const pwmChannelConfigData boardPwmChannels[BOARD_PWM_CHANNEL_COUNT] = {
+		{"/dev/dio/pwm/0", SCT_PWM_PIN_1A, 7, 4, FUNC1},	/* T_COL1 (P7_4) */
+		{"/dev/dio/pwm/1", SCT_PWM_PIN_4A, 1, 5, FUNC1},	/* T_COL0 (P1_5) */
+		{"/dev/dio/pwm/2", SCT_PWM_PIN_2A, 4, 3, FUNC1},	/* T_FIL3 (P4_3) */
+#if BOARD_MOTOR_COUNT == 4
+		{"/dev/dio/pwm/3", SCT_PWM_PIN_3A, 4, 2, FUNC1},	/* T_FIL2 (P4_2) */
+		/* Segundo L293D, con sus ENABLE conectados a los del primero */
+		{"", 1, 4, 1, FUNC1},	/* CTOUT1: T_FIL1 (P4_1) */
+		{"", 2, 4, 4, FUNC1},	/* CTOUT2: LCD1 (P4_4) */
+		{"", 5, 4, 5, FUNC1},	/* CTOUT5: LCD2 (P4_5) */
+		{"", 4, 4, 6, FUNC1}	/* CTOUT4: LCD3 (P4_6) */
+#else
+		{"/dev/dio/pwm/3", SCT_PWM_PIN_3A, 4, 2, FUNC1}	/* T_FIL2 (P4_2) */
+#endif
+};
+
+const motorConfigData boardMotors[BOARD_MOTOR_COUNT] = {
+		{0, 2}, /* Motor 0: T_COL1 para adelante, T_FIL3 para atrás */
+#if BOARD_MOTOR_COUNT == 4
+		{3, 1}, /* Motor 1: T_FIL2 para adelante, T_COL0 para atrás */
+		{4, 5}, /* Motor 2: T_FIL1 para adelante, LCD1 para atrás */
+		{6, 7}  /* Motor 3: LCD2 para adelante, LCD3 para atrás */
+#else
+		{3, 1}  /* Motor 1: T_FIL2 para adelante, T_COL0 para atrás */
+#endif
+};
+
+const encoderConfigData boardEncoders[BOARD_ENCODER_COUNT] = {
+		{
+			0,			// Interrupt channel
+			6, 1,		// P6_1
+			3, 0,		// GPIO0 -> GPIO3[0]
+			4,			// Number of slots in encoder disk
+			ENCODER_BACKEND_PININT,
+			0, 0, 0, 0, 0, 0,	// Sin canal B
+			100			// Pulsos de menos de 100 us son ruido
+		},
+		{
+			1,			// Interrupt channel
+			7, 5,		// P7_5
+			3, 13,		// TEC_COL2 -> GPIO3[13]
+			4,			// Number of slots in encoder disk
+			ENCODER_BACKEND_PININT,
+			0, 0, 0, 0, 0, 0,	// Sin canal B
+			100			// Pulsos de menos de 100 us son ruido
+#if BOARD_MOTOR_COUNT == 4
+		},
+		{
+			2,			// Interrupt channel
+			6, 4,		// P6_4
+			3, 3,		// GPIO1 -> GPIO3[3]
+			4,			// Number of slots in encoder disk
+			ENCODER_BACKEND_PININT,
+			0, 0, 0, 0, 0, 0,	// Sin canal B
+			100			// Pulsos de menos de 100 us son ruido
+		},
+		{
+			3,			// Interrupt channel
+			6, 7,		// P6_7
+			5, 15,		// GPIO3 -> GPIO5[15]
+			4,			// Number of slots in encoder disk
+			ENCODER_BACKEND_PININT,
+			0, 0, 0, 0, 0, 0,	// Sin canal B
+			100			// Pulsos de menos de 100 us son ruido
+#endif
+		}
+};
+
+/*==================[internal functions definition]==========================*/
+
+/*==================[external functions definition]==========================*/
+
+/*==================[end of file]============================================*/
@@ -0,0 +1,145 @@
+/*==================[inclusions]=============================================*/
+
+#include "deadman.h"
+#include "board.h"
+#include "main.h"
+#include "encoder.h"
+#include "pwm.h"
+#include "script.h"
+#include "speed_control.h"
+
+/*==================[macros and definitions]=================================*/
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+/** \brief Detiene los motores, \return Si alguno estaba en movimiento. */
+static uint8_t deadman_stopMotors(void);
+
+/*==================[internal data definition]===============================*/
+
+static uint16_t timeoutMS;
+
+/** \brief Pedido de \p deadman_feed(), que EncoderTask toma en la próxima muestra. */
+static volatile uint8_t fed = 0;
+
+/** \brief Hubo datos desde la última detención o \p deadman_disarm(). */
+static volatile uint8_t armed = 0;
+
+static uint32_t elapsedMS;
+static uint32_t trips = 0;
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+static uint8_t deadman_stopMotors(void)
+{
+	MotorPwmData data[MOTOR_COUNT];
+	uint8_t moving = 0;
+	uint8_t count = 0;
+	uint8_t i;
+
+	script_abort();
+
+	for (i = 0; i < MOTOR_COUNT; i++)
+	{
+		if (ciaaPWM_getMotor(i).dutyCycle != 0)
+		{
+			moving = 1;
+		}
+
+		if (speedControl_hasLimits(i))
+		{
+			/* El control de velocidad toma la consigna en esta misma muestra */
+			speedControl_setDutyCycle(i, 0);
+		}
+		else
+		{
+			speedControl_disable(i);
+
+			data[count].motorID = i;
+			data[count].duty = 0;
+			data[count].direction = DIR_FORWARD;
+			count++;
+		}
+	}
+
+	ciaaPWM_writeMotors(data, count);
+
+	return moving;
+}
+
+/*==================[external functions definition]==========================*/
+
+extern void deadman_init(void)
+{
+	timeoutMS = BOARD_DEADMAN_TIMEOUT_MS;
+	fed = 0;
+	armed = 0;
+	elapsedMS = 0;
+}
+
+
+extern void deadman_setTimeout(uint16_t newTimeoutMS)
+{
+	timeoutMS = newTimeoutMS;
+}
+
+
+extern uint16_t deadman_getTimeout(void)
+{
+	return timeoutMS;
+}
+
+
+extern void deadman_feed(void)
+{
+	fed = 1;
+}
+
+
+extern void deadman_disarm(void)
+{
+	/* En este orden, EncoderTask no puede volver a armarla con un pedido anterior */
+	fed = 0;
+	armed = 0;
+}
+
+
+extern void deadman_update(void)
+{
+	if (fed)
+	{
+		fed = 0;
+		armed = 1;
+		elapsedMS = 0;
+		return;
+	}
+
+	if (!armed || timeoutMS == 0)
+	{
+		return;
+	}
+
+	elapsedMS += encoder_getSamplePeriod();
+
+	if (elapsedMS >= timeoutMS)
+	{
+		armed = 0;
+
+		if (deadman_stopMotors())
+		{
+			trips++;
+		}
+	}
+}
+
+
+extern uint32_t deadman_getTrips(void)
+{
+	return trips;
+}
+
+/*==================[end of file]============================================*/
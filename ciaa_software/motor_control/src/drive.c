@@ -0,0 +1,67 @@
+/*==================[inclusions]=============================================*/
+
+#include "drive.h"
+#include "board.h"
+#include "odometry.h"
+#include "speed_control.h"
+
+/*==================[macros and definitions]=================================*/
+
+/** \brief Pi en Q16. */
+#define PI_Q16					(205887)
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+
+/** \brief Trocha en milímetros. */
+static uint16_t trackMM;
+
+/** \brief Décimas de RPM por mm/s de la rueda, en Q16: 600 / (pi * diámetro). */
+static int32_t tenthsRPMPerMMS;
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+/*==================[external functions definition]==========================*/
+
+extern void drive_init(void)
+{
+	drive_setGeometry(BOARD_WHEEL_DIAMETER_MM, BOARD_TRACK_WIDTH_MM);
+}
+
+
+extern int32_t drive_setGeometry(uint16_t wheelDiameterMM, uint16_t trackWidthMM)
+{
+	/* La odometría valida los valores */
+	if (odometry_setGeometry(wheelDiameterMM, trackWidthMM) < 0)
+	{
+		return -1;
+	}
+
+	trackMM = trackWidthMM;
+	tenthsRPMPerMMS = (int32_t)((600LL << 32) / ((int64_t)PI_Q16 * wheelDiameterMM));
+
+	return 1;
+}
+
+
+extern int32_t drive_setVelocity(int32_t linearMMS, int32_t angularMradS)
+{
+	static const uint8_t motors[2] = {BOARD_LEFT_ENCODER, BOARD_RIGHT_ENCODER};
+	int32_t speeds[2];
+	int32_t turn;
+
+	/* Velocidad de cada rueda respecto del centro, en mm/s */
+	turn = (int32_t)(((int64_t)angularMradS * trackMM) / 2000);
+
+	speeds[0] = (int32_t)(((int64_t)(linearMMS - turn) * tenthsRPMPerMMS) >> 16);
+	speeds[1] = (int32_t)(((int64_t)(linearMMS + turn) * tenthsRPMPerMMS) >> 16);
+
+	return speedControl_setSetpoints(motors, speeds, 2);
+}
+
+/*==================[end of file]============================================*/
@@ -3,61 +3,127 @@
 #include "encoder.h"
 #include "chip.h"
 #include "os.h"               /* <= operating system header */
+#include "timestamp.h"
+#include "perf.h"
+#include "observer.h"
 
 /*==================[macros and definitions]=================================*/
 
 #define GPIO_INTERRUPT	(LPC_GPIO_PIN_INT)
 
+/** \brief Cantidad de canales de interrupcin por pin (PININT). */
+#define PININT_CHANNEL_COUNT	(8)
+
+/** \brief Rutina de interrupcin de un canal PININT: todas existen, y cada flanco se
+ * asigna a su encoder mediante \p channelOwner segn la descripcin de la placa. */
+#define ENCODER_ISR(n)	ISR(GPIO##n##_IRQHandler) \
+						{ \
+							encoder_edge(n); \
+							Chip_PININT_ClearIntStatus(GPIO_INTERRUPT, PININTCH(n)); \
+						}
+
+/** \brief Valor de \p channelOwner para los canales no utilizados. */
+#define CHANNEL_UNUSED			(0xFF)
+
+/** \brief Bits de los registros del QEI. */
+#define QEI_CON_RESP			(1 << 0)	/* Reinicia la posicin */
+#define QEI_CONF_CAPMODE		(1 << 2)	/* Cuenta ambos flancos de ambos canales (4x) */
+
 /*==================[internal data declaration]==============================*/
 
 typedef struct {
-	uint16_t	lastCount;
-	uint16_t	currentCount;
-	uint8_t		nextIndex;
+	uint32_t	lastCount; /* Flancos del ltimo perodo de conteo */
+	volatile uint32_t	edgeCount; /* Slo lo incrementa la interrupcin, nunca se reinicia */
+	uint32_t	periodStartEdges; /* Valor de edgeCount al comenzar el perodo de conteo */
+	uint16_t	nextIndex; /* Posicin de la prxima muestra en history */
+	uint16_t	historyCount; /* Muestras vlidas en history */
+	int16_t		history[ENCODER_HISTORY_LENGTH]; /* Variacin de la posicin en cada perodo de muestreo */
+	int32_t		samplePosition; /* Posicin al tomar la ltima muestra */
+	volatile int32_t	position; /* Actualizada por las interrupciones, o leda del QEI en cada perodo */
+	int32_t		periodStartPosition;
+	int32_t		velocity;
+	int8_t		directionHint;
+	uint8_t		quadratureState; /* ltimo estado (A << 1 | B) del decodificador por software */
+	volatile uint32_t	lastEdgeTime; /* Marca de tiempo del ltimo flanco */
+	volatile uint32_t	edgePeriod; /* Ciclos entre los dos ltimos flancos */
+	volatile int8_t		edgeDirection;
+	volatile uint8_t	validEdges; /* Flancos desde el inicio, hasta 2: el perodo slo es vlido con 2 */
+	uint8_t		countMode; /* SPEED_TYPE_EDGE_TIMED se calcula por conteo */
+	uint32_t	trace[ENCODER_TRACE_LENGTH];
+	volatile uint16_t	traceHead; /* Slo lo escribe la interrupcin */
+	volatile uint16_t	traceTail; /* Slo lo escribe quien lee la traza */
+	volatile uint32_t	traceOverflows;
+	volatile uint16_t	traceGeneration; /* Cambia cada vez que se reinicia el buffer de traza */
+	uint16_t	minPulseUS; /* Filtro de pulsos cortos, 0 lo deshabilita */
+	uint32_t	minPulseCycles;
+	volatile uint32_t	rejectedEdges; /* Flancos descartados por el filtro o por transiciones invlidas */
+	ObserverState	observer;
+	uint32_t	holdEdges; /* Valor de edgeCount con el que la interpolacin lleg a la cuenta siguiente */
+	uint8_t		hold; /* La interpolacin se mantiene saturada hasta el prximo flanco */
 } encoderSampleData;
 
-typedef struct {
-	uint8_t	interruptChannel;
-	uint8_t portNumber;
-	uint8_t pinNumber;
-	uint8_t	gpio_portNumber;
-	uint8_t	gpio_pinNumber;
-	uint8_t diskSlotsNumber;
-} encoderConfigData;
-
 
 /*==================[internal functions declaration]=========================*/
 
 static inline void encoder_configInterrupt(uint8_t intChannel, uint8_t portNum, uint8_t pinNum);
+static void encoder_configInput(uint8_t portNum, uint8_t pinNum, uint8_t gpioPortNum, uint8_t gpioPinNum);
+static inline uint8_t encoder_readQuadratureState(const encoderConfigData * config);
+static void encoder_initQEI(const encoderConfigData * config);
+static inline void encoder_edge(uint8_t intChannel);
+static int32_t encoder_edgeTimedSpeed(uint8_t encoderID);
+static uint32_t encoder_interpolate(encoderSampleData * data, int32_t position, uint32_t edges, uint32_t now);
+static int32_t encoder_startAlarm(void);
+static int32_t encoder_restartCount(void);
+static void encoder_clearHistory(void);
+static int32_t encoder_toRPM(uint8_t encoderID, int32_t counts, uint32_t periodMS, uint16_t scale);
 
 /*==================[internal data definition]===============================*/
 
 static encoderSampleData encoder[ENCODER_COUNT];
 
-static const encoderConfigData encoder0 = {
-		0,			// Interrupt channel
-		6, 1,		// P6_1
-		3, 0,		// GPIO0 -> GPIO3[0]
-		4			// Number of slots in encoder disk
-};
-
-static const encoderConfigData encoder1 = {
-		1,			// Interrupt channel
-		7, 5,		// P7_5
-		3, 13,		// TEC_COL2 -> GPIO3[13]
-		4			// Number of slots in encoder disk
-};
-
-static const encoderConfigData * encoderConfig[ENCODER_COUNT] = {
-		&encoder0,
-		&encoder1
+/** \brief Encoder asociado a cada canal de interrupcin, o \p CHANNEL_UNUSED. */
+static uint8_t channelOwner[PININT_CHANNEL_COUNT];
+
+/** \brief Variacin de la posicin para cada transicin del decodificador por software,
+ * indexada por (estado anterior << 2 | estado nuevo). Las transiciones invlidas (salto
+ * de ambos canales a la vez) no modifican la posicin. */
+static const int8_t quadratureTable[16] = {
+		 0, +1, -1,  0,
+		-1,  0,  0, +1,
+		+1,  0,  0, -1,
+		 0, -1, +1,  0
 };
 
 static callBackTimeElapsedFunction_type timeElapsed_callback = 0;
 
+/** \brief Funcin llamada en cada perodo de muestreo. */
+static callBackSampleFunction_type sample_callback = 0;
+
 /** \brief Indica si la alarma asociada a la tarea EncoderTask est habilitada o no */
 static uint8_t isAlarmRunning = 0;
 
+/** \brief Mscara de encoders con la traza de flancos habilitada. */
+static volatile uint8_t traceMask = 0;
+
+/** \brief Perodo de conteo actual, en milisegundos. */
+static uint16_t countPeriodMS = 1000;
+
+/** \brief Perodo de conteo pedido en \p encoder_beginCount(), antes de redondearlo al perodo de muestreo. */
+static uint16_t requestedCountPeriodMS = 1000;
+
+/** \brief Pedido de \p encoder_setSamplePeriod() de descartar la historia, que EncoderTask toma en la prxima muestra. */
+static volatile uint8_t clearRequested = 0;
+
+/** \brief Perodo de muestreo actual, en milisegundos. */
+static uint16_t samplePeriodMS = ENCODER_DEFAULT_SAMPLE_PERIOD_MS;
+
+/** \brief Ganancias del observador de velocidad, comunes a todos los encoders. */
+static ObserverGains observerGains;
+
+/** \brief Cantidad de muestras por perodo de conteo, y las que faltan para el fin del actual. */
+static uint16_t samplesPerCount = 1000 / ENCODER_DEFAULT_SAMPLE_PERIOD_MS;
+static uint16_t samplesLeft = 1000 / ENCODER_DEFAULT_SAMPLE_PERIOD_MS;
+
 /*==================[external data definition]===============================*/
 
 /*==================[internal functions definition]==========================*/
@@ -68,48 +134,371 @@ static inline void encoder_configInterrupt(uint8_t intChannel, uint8_t portNum,
 	Chip_PININT_EnableIntLow(GPIO_INTERRUPT, PININTCH(intChannel));
 }
 
-/*==================[external functions definition]==========================*/
 
-extern void encoder_init(void)
+static void encoder_configInput(uint8_t portNum, uint8_t pinNum, uint8_t gpioPortNum, uint8_t gpioPinNum)
 {
-	uint8_t encoderID;
+    /* Seteo la funcionalidad GPIO del pin, con el filtro de glitches del SCU habilitado
+	   (sin MD_ZI), que descarta en hardware los pulsos de pocos nanosegundos */
+	Chip_SCU_PinMux(portNum, pinNum, MD_PUP|MD_EZI, FUNC0);
 
-	Chip_PININT_Init(GPIO_INTERRUPT);
+	/* Lo configuro como entrada */
+	Chip_GPIO_SetDir(LPC_GPIO_PORT, gpioPortNum, (1 << gpioPinNum), 0);
+}
 
-	for (encoderID = 0; encoderID < ENCODER_COUNT; encoderID++)
+
+static inline uint8_t encoder_readQuadratureState(const encoderConfigData * config)
+{
+	return (Chip_GPIO_GetPinState(LPC_GPIO_PORT, config->gpio_portNumber, config->gpio_pinNumber) << 1) |
+			Chip_GPIO_GetPinState(LPC_GPIO_PORT, config->gpio_portNumberB, config->gpio_pinNumberB);
+}
+
+
+static void encoder_initQEI(const encoderConfigData * config)
+{
+	Chip_Clock_Enable(CLK_MX_QEI);
+
+	Chip_SCU_PinMux(config->portNumber, config->pinNumber, MD_PUP|MD_EZI, config->pinFunction);
+	Chip_SCU_PinMux(config->portNumberB, config->pinNumberB, MD_PUP|MD_EZI, config->pinFunction);
+
+	/* Contador de 32 bits que da la vuelta, la diferencia entre dos lecturas siempre es vlida */
+	LPC_QEI->MAXPOS = 0xFFFFFFFF;
+	/* Cada fase debe mantenerse estable el ancho mnimo de pulso para ser aceptada */
+	LPC_QEI->FILTERPHA = config->minPulseUS * timestamp_cyclesPerMicrosecond();
+	LPC_QEI->FILTERPHB = config->minPulseUS * timestamp_cyclesPerMicrosecond();
+	LPC_QEI->CONF = QEI_CONF_CAPMODE;
+	LPC_QEI->CON = QEI_CON_RESP;
+}
+
+
+/** \brief Procesa un flanco en un canal de interrupcin, llamada desde las ISR. */
+static inline void encoder_edge(uint8_t intChannel)
+{
+	uint32_t now = timestamp_now();
+	uint8_t encoderID = channelOwner[intChannel];
+	encoderSampleData * data;
+	uint8_t state;
+	uint16_t next;
+	int8_t delta;
+
+	if (encoderID >= ENCODER_COUNT)
+	{
+		return;
+	}
+
+	data = &encoder[encoderID];
+
+	if (boardEncoders[encoderID].backend == ENCODER_BACKEND_SOFT_QUADRATURE)
 	{
-	    /* Seteo la funcionalidad GPIO de cada pin */
-		Chip_SCU_PinMux(encoderConfig[encoderID]->portNumber, encoderConfig[encoderID]->pinNumber, MD_PUP|MD_EZI|MD_ZI, FUNC0);
+		state = encoder_readQuadratureState(&boardEncoders[encoderID]);
+		delta = quadratureTable[(data->quadratureState << 2) | state];
+		data->quadratureState = state;
+
+		/* Un rebote se cancela solo en la tabla (+1 y -1); una transicin invlida no cuenta */
+		if (delta == 0)
+		{
+			data->rejectedEdges++;
+			return;
+		}
+	}
+	else
+	{
+		/* Filtro de pulsos cortos: el pin debe seguir en bajo luego del flanco descendente
+		   (si no, fue un pulso ms corto que la latencia de la interrupcin), y no pudo
+		   haber otro flanco aceptado hace menos del ancho mnimo (rebote) */
+		if (data->minPulseCycles != 0 &&
+			(now - data->lastEdgeTime < data->minPulseCycles ||
+			 Chip_GPIO_GetPinState(LPC_GPIO_PORT, boardEncoders[encoderID].gpio_portNumber, boardEncoders[encoderID].gpio_pinNumber)))
+		{
+			data->rejectedEdges++;
+			return;
+		}
+
+		delta = data->directionHint;
+	}
 
-		/* Lo configuro como entrada */
-		Chip_GPIO_SetDir(LPC_GPIO_PORT, encoderConfig[encoderID]->gpio_portNumber, (1 << encoderConfig[encoderID]->gpio_pinNumber), 0);
+	data->position += delta;
+	data->edgeCount++;
+
+	/* Un cambio de sentido invalida el intervalo medido */
+	if (delta != data->edgeDirection)
+	{
+		data->edgeDirection = delta;
+		data->validEdges = 0;
+	}
 
-        /* Activo interrupcin GPIO, cada una en un canal diferente */
-		encoder_configInterrupt(encoderConfig[encoderID]->interruptChannel,
-								encoderConfig[encoderID]->gpio_portNumber,
-								encoderConfig[encoderID]->gpio_pinNumber);
+	data->edgePeriod = now - data->lastEdgeTime;
+	data->lastEdgeTime = now;
+	if (data->validEdges < 2)
+	{
+		data->validEdges++;
 	}
 
+	if (traceMask & (1 << encoderID))
+	{
+		next = (data->traceHead + 1) & (ENCODER_TRACE_LENGTH - 1);
+		if (next != data->traceTail)
+		{
+			data->trace[data->traceHead] = (delta < 0 ? data->edgePeriod | ENCODER_TRACE_BACKWARD : data->edgePeriod);
+			data->traceHead = next;
+		}
+		else
+		{
+			data->traceOverflows++;
+		}
+	}
 }
 
 
-extern void encoder_beginCount(uint16_t periodMS)
+/** \brief Reinicia la alarma de muestreo, comenzando un nuevo perodo de conteo. \return Si es negativo, no se pudo iniciar. */
+static int32_t encoder_startAlarm(void)
 {
-
 	if (isAlarmRunning)
 	{
 		CancelAlarm(ActivateEncoderTask);
 		isAlarmRunning = 0;
 	}
 
+	samplesLeft = samplesPerCount;
+
+	if (SetRelAlarm(ActivateEncoderTask, samplePeriodMS, samplePeriodMS) != E_OK)
+	{
+		return -1;
+	}
+	isAlarmRunning = 1;
+
+	return 1;
+}
+
+
+/** \brief Comienza un nuevo perodo de conteo con el perodo pedido y el de muestreo actual. */
+static int32_t encoder_restartCount(void)
+{
+	samplesPerCount = (requestedCountPeriodMS < samplePeriodMS ? 1 : requestedCountPeriodMS / samplePeriodMS);
+	countPeriodMS = samplesPerCount * samplePeriodMS;
+
 	encoder_resetCount();
 
-	if (!isAlarmRunning)
+	return encoder_startAlarm();
+}
+
+
+static void encoder_clearHistory(void)
+{
+	uint8_t encoderID;
+
+	for (encoderID = 0; encoderID < ENCODER_COUNT; encoderID++)
 	{
-		SetRelAlarm(ActivateEncoderTask, periodMS, periodMS);
-		isAlarmRunning = 1;
+		encoder[encoderID].nextIndex = 0;
+		encoder[encoderID].historyCount = 0;
+		encoder[encoderID].samplePosition = encoder_getPosition(encoderID);
+
+		/* La velocidad del observador est en cuentas por muestra, se reinicia con el perodo */
+		observer_reset(&encoder[encoderID].observer, observer_toQ16(encoder[encoderID].samplePosition));
+		encoder[encoderID].hold = 0;
 	}
+}
+
 
+/** \brief Posicin medida en Q16, interpolada entre cuentas con el tiempo desde el ltimo flanco.
+ *
+ * La posicin entera slo cambia en cada flanco: entre flancos, se le suma la fraccin
+ * del ltimo intervalo entre flancos transcurrida desde el ltimo, suponiendo velocidad
+ * constante. La fraccin se satura justo antes de la cuenta siguiente, ya que sin un
+ * nuevo flanco el encoder no lleg a ella, y se mantiene saturada hasta el prximo flanco
+ * (as no vuelve a crecer desde 0 cuando el contador de ciclos da la vuelta).
+ * Los encoders ledos por el QEI no tienen marcas de tiempo y usan la posicin entera.
+ *
+ */
+static uint32_t encoder_interpolate(encoderSampleData * data, int32_t position, uint32_t edges, uint32_t now)
+{
+	uint32_t elapsed;
+	uint32_t fraction;
+
+	if (data->validEdges < 2 || data->edgePeriod == 0)
+	{
+		return observer_toQ16(position);
+	}
+
+	elapsed = now - data->lastEdgeTime;
+
+	if ((data->hold && data->holdEdges == edges) || elapsed >= data->edgePeriod)
+	{
+		data->hold = 1;
+		data->holdEdges = edges;
+		fraction = OBSERVER_ONE - 1;
+	}
+	else
+	{
+		data->hold = 0;
+		fraction = (uint32_t)(((uint64_t)elapsed << OBSERVER_Q_BITS) / data->edgePeriod);
+	}
+
+	return observer_toQ16(position) + (data->edgeDirection < 0 ? -fraction : fraction);
+}
+
+
+/** \brief Convierte flancos contados durante un tiempo a RPM, multiplicadas por \p scale. */
+static int32_t encoder_toRPM(uint8_t encoderID, int32_t counts, uint32_t periodMS, uint16_t scale)
+{
+	uint16_t countsPerRevolution = encoder_getCountsPerRevolution(encoderID);
+
+	if (periodMS == 0 || countsPerRevolution == 0)
+	{
+		return 0;
+	}
+
+	return (int32_t)(((int64_t)counts * 60000 * scale) / ((int64_t)periodMS * countsPerRevolution));
+}
+
+
+/** \brief Velocidad en dcimas de RPM a partir del tiempo entre flancos. */
+static int32_t encoder_edgeTimedSpeed(uint8_t encoderID)
+{
+	encoderSampleData * data = &encoder[encoderID];
+	uint32_t lastEdgeTime;
+	uint32_t period;
+	uint32_t elapsed;
+	int8_t direction;
+
+	/* Las lecturas se repiten si un flanco las interrumpi, para que sean coherentes entre s */
+	do
+	{
+		lastEdgeTime = data->lastEdgeTime;
+		period = data->edgePeriod;
+		direction = data->edgeDirection;
+	} while (lastEdgeTime != data->lastEdgeTime);
+
+	if (data->validEdges < 2)
+	{
+		return 0;
+	}
+
+	/* Si el prximo flanco ya se demor ms que el ltimo intervalo, el motor va al menos as de lento */
+	elapsed = timestamp_now() - lastEdgeTime;
+
+	if (elapsed > (uint32_t)ENCODER_EDGE_TIMEOUT_MS * 1000 * timestamp_cyclesPerMicrosecond())
+	{
+		return 0;
+	}
+
+	if (elapsed > period)
+	{
+		period = elapsed;
+	}
+
+	/* Dcimas de RPM: (ciclos por segundo / ciclos por flanco) * 60 * 10 / flancos por vuelta */
+	return direction * (int32_t)(((uint64_t)timestamp_cyclesPerMicrosecond() * 1000000 * 600) /
+			((uint64_t)period * encoder_getCountsPerRevolution(encoderID)));
+}
+
+/*==================[external functions definition]==========================*/
+
+extern int32_t encoder_init(void)
+{
+	const encoderConfigData * config;
+	uint8_t encoderID;
+	uint8_t qeiUsed = 0;
+
+	Chip_PININT_Init(GPIO_INTERRUPT);
+	timestamp_init();
+
+	for (encoderID = 0; encoderID < PININT_CHANNEL_COUNT; encoderID++)
+	{
+		channelOwner[encoderID] = CHANNEL_UNUSED;
+	}
+
+	for (encoderID = 0; encoderID < ENCODER_COUNT; encoderID++)
+	{
+		config = &boardEncoders[encoderID];
+
+		encoder[encoderID].position = 0;
+		encoder[encoderID].periodStartPosition = 0;
+		encoder[encoderID].velocity = 0;
+		encoder[encoderID].directionHint = 1;
+		encoder[encoderID].edgeDirection = 1;
+		encoder[encoderID].validEdges = 0;
+		encoder[encoderID].countMode = 0;
+		encoder[encoderID].rejectedEdges = 0;
+		encoder[encoderID].minPulseUS = config->minPulseUS;
+		encoder[encoderID].minPulseCycles = config->minPulseUS * timestamp_cyclesPerMicrosecond();
+
+		switch (config->backend)
+		{
+		case ENCODER_BACKEND_QEI:
+			/* Hay un nico QEI: un segundo encoder compartira su contador */
+			if (qeiUsed)
+			{
+				return -1;
+			}
+			qeiUsed = 1;
+
+			encoder_initQEI(config);
+			break;
+
+		case ENCODER_BACKEND_SOFT_QUADRATURE:
+			encoder_configInput(config->portNumberB, config->pinNumberB, config->gpio_portNumberB, config->gpio_pinNumberB);
+			encoder_configInput(config->portNumber, config->pinNumber, config->gpio_portNumber, config->gpio_pinNumber);
+			encoder[encoderID].quadratureState = encoder_readQuadratureState(config);
+
+			/* Ambos canales interrumpen en ambos flancos */
+			channelOwner[config->interruptChannel] = encoderID;
+			channelOwner[config->interruptChannelB] = encoderID;
+			encoder_configInterrupt(config->interruptChannel, config->gpio_portNumber, config->gpio_pinNumber);
+			Chip_PININT_EnableIntHigh(GPIO_INTERRUPT, PININTCH(config->interruptChannel));
+			encoder_configInterrupt(config->interruptChannelB, config->gpio_portNumberB, config->gpio_pinNumberB);
+			Chip_PININT_EnableIntHigh(GPIO_INTERRUPT, PININTCH(config->interruptChannelB));
+			break;
+
+		case ENCODER_BACKEND_PININT:
+		default:
+			encoder_configInput(config->portNumber, config->pinNumber, config->gpio_portNumber, config->gpio_pinNumber);
+
+	        /* Activo interrupcin GPIO, cada una en un canal diferente */
+			channelOwner[config->interruptChannel] = encoderID;
+			encoder_configInterrupt(config->interruptChannel, config->gpio_portNumber, config->gpio_pinNumber);
+			break;
+		}
+	}
+
+	observer_setGains(&observerGains, ENCODER_DEFAULT_OBSERVER_ALPHA);
+	encoder_clearHistory();
+
+	return 1;
+}
+
+
+extern void encoder_beginCount(uint16_t periodMS)
+{
+	requestedCountPeriodMS = periodMS;
+	encoder_restartCount();
+}
+
+
+extern int32_t encoder_setSamplePeriod(uint16_t periodMS)
+{
+	if (periodMS == 0 || periodMS > ENCODER_MAX_SAMPLE_PERIOD_MS)
+	{
+		return -1;
+	}
+
+	samplePeriodMS = periodMS;
+
+	/* La historia la descarta EncoderTask, que de otro modo podra interrumpir el reinicio */
+	clearRequested = 1;
+
+	if (isAlarmRunning)
+	{
+		/* Con el perodo de conteo pedido, as los redondeos no se acumulan */
+		return encoder_restartCount();
+	}
+
+	return 1;
+}
+
+
+extern uint16_t encoder_getSamplePeriod(void)
+{
+	return samplePeriodMS;
 }
 
 
@@ -119,7 +508,19 @@ extern void encoder_setTimeElapsedCallback(callBackTimeElapsedFunction_type fcnP
 }
 
 
-extern uint16_t encoder_getLastCount(uint8_t encoderID)
+extern void encoder_setSampleCallback(callBackSampleFunction_type fcnPtr)
+{
+	sample_callback = fcnPtr;
+}
+
+
+extern int32_t encoder_getSamplePosition(uint8_t encoderID)
+{
+	return (encoderID < ENCODER_COUNT ? encoder[encoderID].samplePosition : 0);
+}
+
+
+extern uint32_t encoder_getLastCount(uint8_t encoderID)
 {
 	return (encoderID < ENCODER_COUNT ? encoder[encoderID].lastCount : 0);
 }
@@ -130,47 +531,380 @@ extern void encoder_resetCount(void)
 	uint8_t encoderID;
 
 	for (encoderID = 0; encoderID < ENCODER_COUNT; encoderID++){
-		encoder[encoderID].currentCount = 0;
+		/* Slo se mueve la referencia: los contadores de las interrupciones no se modifican */
+		encoder[encoderID].periodStartEdges = encoder[encoderID].edgeCount;
+		encoder[encoderID].periodStartPosition = encoder_getPosition(encoderID);
+	}
+}
+
+
+extern int32_t encoder_getPosition(uint8_t encoderID)
+{
+	if (encoderID >= ENCODER_COUNT)
+	{
+		return 0;
+	}
+
+	/* El QEI se lee recin cuando se necesita, sin interrupciones por flanco. Como su contador
+	   da la vuelta en 32 bits, su valor ya es la posicin con signo desde el inicio. */
+	if (boardEncoders[encoderID].backend == ENCODER_BACKEND_QEI)
+	{
+		return (int32_t)LPC_QEI->POS;
+	}
+
+	return encoder[encoderID].position;
+}
+
+
+extern int32_t encoder_getVelocity(uint8_t encoderID)
+{
+	return (encoderID < ENCODER_COUNT ? encoder[encoderID].velocity : 0);
+}
+
+
+extern uint16_t encoder_getCountsPerRevolution(uint8_t encoderID)
+{
+	if (encoderID >= ENCODER_COUNT)
+	{
+		return 0;
+	}
+
+	return boardEncoders[encoderID].diskSlotsNumber *
+			(boardEncoders[encoderID].backend == ENCODER_BACKEND_PININT ? 1 : 4);
+}
+
+
+extern int32_t encoder_setObserverGain(uint16_t alphaMilli)
+{
+	return observer_setGains(&observerGains, alphaMilli);
+}
+
+
+extern int32_t encoder_setGlitchFilter(uint8_t encoderID, uint16_t minPulseUS)
+{
+	if (encoderID >= ENCODER_COUNT)
+	{
+		return -1;
+	}
+
+	encoder[encoderID].minPulseUS = minPulseUS;
+
+	if (boardEncoders[encoderID].backend == ENCODER_BACKEND_QEI)
+	{
+		LPC_QEI->FILTERPHA = minPulseUS * timestamp_cyclesPerMicrosecond();
+		LPC_QEI->FILTERPHB = minPulseUS * timestamp_cyclesPerMicrosecond();
+	}
+	else
+	{
+		encoder[encoderID].minPulseCycles = minPulseUS * timestamp_cyclesPerMicrosecond();
+	}
+
+	return 1;
+}
+
+
+extern uint16_t encoder_getGlitchFilter(uint8_t encoderID)
+{
+	return (encoderID < ENCODER_COUNT ? encoder[encoderID].minPulseUS : 0);
+}
+
+
+extern uint32_t encoder_getRejectedEdges(uint8_t encoderID)
+{
+	return (encoderID < ENCODER_COUNT ? encoder[encoderID].rejectedEdges : 0);
+}
+
+
+extern void encoder_setDirectionHint(uint8_t encoderID, int8_t sign)
+{
+	if (encoderID < ENCODER_COUNT)
+	{
+		encoder[encoderID].directionHint = (sign < 0 ? -1 : 1);
+	}
+}
+
+
+extern int32_t encoder_getSpeed(uint8_t encoderID, SpeedType type)
+{
+	if (encoderID >= ENCODER_COUNT || encoder_getCountsPerRevolution(encoderID) == 0)
+	{
+		return 0;
+	}
+
+	switch (type)
+	{
+	case SPEED_TYPE_INTERRUPTS:
+		return encoder[encoderID].lastCount;
+
+	case SPEED_TYPE_RPM:
+		return encoder_toRPM(encoderID, encoder[encoderID].velocity, countPeriodMS, 1);
+
+	case SPEED_TYPE_EDGE_TIMED:
+		if (encoder[encoderID].countMode || boardEncoders[encoderID].backend == ENCODER_BACKEND_QEI)
+		{
+			return encoder_toRPM(encoderID, encoder[encoderID].velocity, countPeriodMS, 10);
+		}
+		return encoder_edgeTimedSpeed(encoderID);
+
+	case SPEED_TYPE_OBSERVED:
+		/* Q16 cuentas por muestra a dcimas de RPM */
+		return (int32_t)(((int64_t)encoder[encoderID].observer.velocity * 600000) /
+				((int64_t)samplePeriodMS * encoder_getCountsPerRevolution(encoderID) << OBSERVER_Q_BITS));
+
+	default:
+		return 0;
+	}
+}
+
+
+extern void encoder_setTraceMask(uint8_t encoderMask)
+{
+	uint8_t encoderID;
+
+	/* Quien lee la traza no puede avanzar traceTail mientras se reinicia */
+	GetResource(TRACER);
+
+	for (encoderID = 0; encoderID < ENCODER_COUNT; encoderID++)
+	{
+		if ((encoderMask & ~traceMask) & (1 << encoderID))
+		{
+			/* La interrupcin todava no escribe este buffer, se puede reiniciar */
+			encoder[encoderID].traceHead = 0;
+			encoder[encoderID].traceTail = 0;
+			encoder[encoderID].traceOverflows = 0;
+			encoder[encoderID].traceGeneration++;
+		}
+	}
+
+	traceMask = encoderMask & ((1 << ENCODER_COUNT) - 1);
+
+	ReleaseResource(TRACER);
+}
+
+
+extern uint16_t encoder_peekTrace(uint8_t encoderID, uint32_t * buf, uint16_t maxEntries)
+{
+	uint16_t head;
+	uint16_t tail;
+	uint16_t count = 0;
+
+	if (encoderID >= ENCODER_COUNT)
+	{
+		return 0;
+	}
+
+	head = encoder[encoderID].traceHead;
+	tail = encoder[encoderID].traceTail;
+
+	while (tail != head && count < maxEntries)
+	{
+		buf[count++] = encoder[encoderID].trace[tail];
+		tail = (tail + 1) & (ENCODER_TRACE_LENGTH - 1);
+	}
+
+	return count;
+}
+
+
+extern uint16_t encoder_getTraceGeneration(uint8_t encoderID)
+{
+	return (encoderID < ENCODER_COUNT ? encoder[encoderID].traceGeneration : 0);
+}
+
+
+extern void encoder_consumeTrace(uint8_t encoderID, uint16_t entries, uint16_t generation)
+{
+	if (encoderID < ENCODER_COUNT)
+	{
+		GetResource(TRACER);
+
+		/* Si el buffer se reinici despus de leer las entradas, ya no estn */
+		if (encoder[encoderID].traceGeneration == generation)
+		{
+			encoder[encoderID].traceTail = (encoder[encoderID].traceTail + entries) & (ENCODER_TRACE_LENGTH - 1);
+		}
+
+		ReleaseResource(TRACER);
+	}
+}
+
+
+extern uint32_t encoder_getTraceOverflows(uint8_t encoderID)
+{
+	return (encoderID < ENCODER_COUNT ? encoder[encoderID].traceOverflows : 0);
+}
+
+
+extern int32_t encoder_getWindowSpeed(uint8_t encoderID, uint16_t windowMS, SpeedType type)
+{
+	encoderSampleData * data;
+	uint16_t samples;
+	uint16_t index;
+	uint16_t i;
+	int32_t sum = 0;
+	int32_t edges = 0;
+
+	if (encoderID >= ENCODER_COUNT)
+	{
+		return 0;
+	}
+
+	data = &encoder[encoderID];
+
+	samples = (windowMS + samplePeriodMS / 2) / samplePeriodMS;
+	if (samples == 0)
+	{
+		samples = 1;
+	}
+	if (samples > data->historyCount)
+	{
+		samples = data->historyCount;
+	}
+
+	/* Se recorre la historia desde la muestra ms reciente hacia atrs */
+	index = data->nextIndex;
+	for (i = 0; i < samples; i++)
+	{
+		index = (index == 0 ? ENCODER_HISTORY_LENGTH : index) - 1;
+		sum += data->history[index];
+		edges += (data->history[index] < 0 ? -data->history[index] : data->history[index]);
+	}
+
+	switch (type)
+	{
+	case SPEED_TYPE_INTERRUPTS:
+		return edges;
+	case SPEED_TYPE_RPM:
+		return encoder_toRPM(encoderID, sum, (uint32_t)samples * samplePeriodMS, 1);
+	case SPEED_TYPE_EDGE_TIMED:
+	case SPEED_TYPE_OBSERVED:
+		return encoder_toRPM(encoderID, sum, (uint32_t)samples * samplePeriodMS, 10);
+	default:
+		return 0;
 	}
 }
 
 
 /** \brief EncoderTask
  *
- * Tarea que efectiviza el conteo actual de interrupciones como el total del
- * perodo, reinicia la cuenta para el prximo perodo de conteo, y notifica
- * al usuario la disponibilidad de los datos del ltimo perodo.
+ * Tarea peridica que toma una muestra de la posicin de cada encoder. Al
+ * completarse un perodo de conteo, efectiviza el conteo actual de interrupciones
+ * como el total del perodo, reinicia la cuenta para el prximo perodo de conteo,
+ * y notifica al usuario la disponibilidad de los datos del ltimo perodo.
  *
  */
 TASK(EncoderTask)
 {
 	uint8_t encoderID;
+	int32_t positions[ENCODER_COUNT];
+	uint32_t edges[ENCODER_COUNT];
+	uint32_t measured[ENCODER_COUNT];
+	int32_t position;
+	int32_t sample;
+	encoderSampleData * data;
+	uint8_t periodEnded = 0;
+	uint32_t start = perf_begin();
+	uint32_t observerStart;
+
+	if (clearRequested)
+	{
+		clearRequested = 0;
+		encoder_clearHistory();
+	}
 
+	/* Instantnea de todos los encoders en el mismo instante, antes de cualquier otro clculo.
+	   Son lecturas atmicas de 32 bits de contadores que slo escriben las interrupciones,
+	   por lo que no hace falta deshabilitarlas ni se pierde ningn flanco. Si un flanco
+	   interrumpe la lectura de un encoder, sta se repite para que la posicin y la marca
+	   de tiempo de su ltimo flanco sean coherentes. */
 	for (encoderID = 0; encoderID < ENCODER_COUNT; encoderID++){
-		encoder[encoderID].lastCount = encoder[encoderID].currentCount;
-		encoder[encoderID].currentCount = 0;
+		data = &encoder[encoderID];
+		do
+		{
+			edges[encoderID] = data->edgeCount;
+			positions[encoderID] = encoder_getPosition(encoderID);
+			measured[encoderID] = encoder_interpolate(data, positions[encoderID], edges[encoderID], timestamp_now());
+		} while (edges[encoderID] != data->edgeCount);
 	}
 
-    /* Si hay un callback registrado, lo llamo */
-	if (timeElapsed_callback != 0)
-	{
-		timeElapsed_callback();
+	observerStart = perf_begin();
+	for (encoderID = 0; encoderID < ENCODER_COUNT; encoderID++){
+		observer_update(&encoder[encoderID].observer, &observerGains, measured[encoderID]);
 	}
+	perf_end(PERF_OBSERVER, observerStart);
 
-	TerminateTask();
-}
+	for (encoderID = 0; encoderID < ENCODER_COUNT; encoderID++){
+		data = &encoder[encoderID];
+		position = positions[encoderID];
+
+		/* Muestra del perodo de muestreo, saturada a 16 bits */
+		sample = position - data->samplePosition;
+		data->samplePosition = position;
+		data->history[data->nextIndex] = (sample > 32767 ? 32767 : (sample < -32768 ? -32768 : sample));
+		data->nextIndex = (data->nextIndex + 1) % ENCODER_HISTORY_LENGTH;
+		if (data->historyCount < ENCODER_HISTORY_LENGTH)
+		{
+			data->historyCount++;
+		}
+	}
 
+	/* Fin del perodo de conteo */
+	if (--samplesLeft == 0)
+	{
+		samplesLeft = samplesPerCount;
+		periodEnded = 1;
+
+		for (encoderID = 0; encoderID < ENCODER_COUNT; encoderID++){
+			data = &encoder[encoderID];
+			data->velocity = positions[encoderID] - data->periodStartPosition;
+			data->periodStartPosition = positions[encoderID];
+
+			if (boardEncoders[encoderID].backend == ENCODER_BACKEND_QEI)
+			{
+				/* El QEI no genera interrupciones: la cantidad de flancos es la variacin de la posicin */
+				data->lastCount = (data->velocity < 0 ? -data->velocity : data->velocity);
+			}
+			else
+			{
+				/* La resta en 32 bits sin signo es correcta aunque el contador haya dado la vuelta */
+				data->lastCount = edges[encoderID] - data->periodStartEdges;
+			}
+			data->periodStartEdges = edges[encoderID];
+
+			/* Cambio entre medicin por tiempo entre flancos y por conteo, con histresis */
+			if (encoder[encoderID].lastCount >= ENCODER_COUNT_MODE_ENTER)
+			{
+				encoder[encoderID].countMode = 1;
+			}
+			else if (encoder[encoderID].lastCount < ENCODER_COUNT_MODE_EXIT)
+			{
+				encoder[encoderID].countMode = 0;
+			}
+		}
+	}
 
-ISR(GPIO0_IRQHandler)
-{
-	encoder[0].currentCount++;
-	Chip_PININT_ClearIntStatus(GPIO_INTERRUPT, PININTCH(encoderConfig[0]->interruptChannel));
-}
+	perf_end(PERF_ENCODER_TASK, start);
 
+	if (sample_callback != 0)
+	{
+		sample_callback();
+	}
 
-ISR(GPIO1_IRQHandler)
-{
-	encoder[1].currentCount++;
-	Chip_PININT_ClearIntStatus(GPIO_INTERRUPT, PININTCH(encoderConfig[1]->interruptChannel));
+    /* Si termin el perodo de conteo y hay un callback registrado, lo llamo */
+	if (periodEnded && timeElapsed_callback != 0)
+	{
+		timeElapsed_callback();
+	}
+
+	TerminateTask();
 }
 
+
+ENCODER_ISR(0)
+ENCODER_ISR(1)
+ENCODER_ISR(2)
+ENCODER_ISR(3)
+ENCODER_ISR(4)
+ENCODER_ISR(5)
+ENCODER_ISR(6)
+ENCODER_ISR(7)
@@ -33,8 +33,15 @@
 #define internalBuffer_deleteFrontData(dataInfo) ciaaLibs_circBufUpdateHead(&circBuffer, internalBuffer_getWrittenLength(dataInfo))
 #define internalBuffer_sendData(dataInfo) ciaaLibs_circBufWriteTo(&circBuffer, fd_uart, (dataInfo))
 
+#define isSendCommand(command) ((command) == AT_CIPSEND || (command) == AT_CIPSENDEX || (command) == AT_CIPSENDBUF)
 
-#define isCommandWaitFunctionDefined(command) (waitFunctions[(command)] != NULL)
+#define hasCapability(cap) ((capabilities & (cap)) != 0)
+
+/** \brief Versión mínima del firmware AT que informa "SEND OK" (0.40). */
+#define FIRMWARE_VERSION_SEND_OK		(0x0028)
+
+/** \brief Versión mínima del firmware AT que informa el número de segmento en AT+CIPSENDBUF (1.0). */
+#define FIRMWARE_VERSION_SEGMENT_ID		(0x0100)
 
 /*==================[internal data declaration]==============================*/
 
@@ -56,6 +63,8 @@ typedef struct {
 	AT_Type                     type;
 	InternalBufferedDataInfo    paramsData;
 	ContentType                 contentInfo;
+	uint8_t                     connectionID; /* Sólo válido para comandos de envío de datos */
+	uint8_t                     capability; /* Si no es 0, el comando es parte del sondeo y su respuesta indica si existe esta funcionalidad */
 	union{
 		InternalBufferedDataInfo internal;
 		ExternalBufferedDataInfo external;
@@ -88,6 +97,7 @@ static int32_t paramsToString_cipserver(QueuedCommand* commandData, void* parame
 /* Funciones de ayuda para mantener la cola de comandos */
 static int32_t queue_cmd_push(QueuedCommand newCommand);
 static QueuedCommand queue_cmd_pop(void);
+static void queue_cmd_finished(const QueuedCommand * cmd);
 static uint8_t queue_cmd_isEmpty(void);
 
 /* Funciones de espera que serán utilizadas */
@@ -95,6 +105,12 @@ static int8_t waitForAny(const char ** str, uint8_t size);
 static WaitResult rst_wait(void);
 static WaitResult wait_OK_busy_error(void);
 static WaitResult wait_cipsend(void);
+static WaitResult wait_gmr(void);
+
+/* Funciones para el sondeo de funcionalidades del firmware AT */
+static void queueProbeCommand(AT_Command command, AT_Type type, uint8_t capability);
+static AT_Command resolveCommand(AT_Command command, AT_Type type);
+static waitFunction_type getWaitFunction(const QueuedCommand * cmd);
 
 
 /*==================[internal data definition]===============================*/
@@ -109,7 +125,10 @@ static const char * AT_Command_string[AT_COMMAND_SIZE] = {
 		"AT+CIPSERVER",
 		"AT+CIPSEND",
 		"AT+CIPSENDEX",
-		"AT+CIPSENDBUF"
+		"AT+CIPSENDBUF",
+		"AT+GMR",
+		"AT+UART_CUR",
+		"AT+CIPMODE"
 };
 
 static const char * AT_Type_string[4] = {
@@ -128,13 +147,16 @@ static const uint8_t valid_types[AT_COMMAND_SIZE] = {
 		AT_TYPE_EXECUTE,                            /* <= AT+RST */
 		AT_TYPE_QUERY | AT_TYPE_SET | AT_TYPE_TEST, /* <= AT+CWMODE */
 		AT_TYPE_QUERY | AT_TYPE_SET,                /* <= AT+CWSAP */
-		AT_TYPE_QUERY | AT_TYPE_SET,                /* <= AT+CWSAP_CUR */
+		AT_TYPE_QUERY | AT_TYPE_SET | AT_TYPE_TEST, /* <= AT+CWSAP_CUR */
 		AT_TYPE_QUERY | AT_TYPE_SET,                /* <= AT+CWSAP_DEF */
 		AT_TYPE_QUERY | AT_TYPE_SET,                /* <= AT+CIPMUX */
 		AT_TYPE_QUERY | AT_TYPE_SET,                /* <= AT+CIPSERVER */
-		AT_TYPE_SET,                                /* <= AT+CIPSEND */
-		AT_TYPE_SET,                                /* <= AT+CIPSENDEX */
-		AT_TYPE_SET,                                /* <= AT+CIPSENDBUF */
+		AT_TYPE_SET | AT_TYPE_TEST,                 /* <= AT+CIPSEND */
+		AT_TYPE_SET | AT_TYPE_TEST,                 /* <= AT+CIPSENDEX */
+		AT_TYPE_SET | AT_TYPE_TEST,                 /* <= AT+CIPSENDBUF */
+		AT_TYPE_EXECUTE,                            /* <= AT+GMR */
+		AT_TYPE_QUERY | AT_TYPE_TEST,               /* <= AT+UART_CUR */
+		AT_TYPE_QUERY | AT_TYPE_TEST                /* <= AT+CIPMODE */
 };
 
 /** \brief Asociación de funciones para armar los argumentos con cada comando.
@@ -160,7 +182,10 @@ static const paramsToString_type paramsToString[AT_COMMAND_SIZE] = {
 		&paramsToString_cipserver,
 		&paramsToString_cipsend,
 		&paramsToString_cipsend,
-		&paramsToString_cipsend
+		&paramsToString_cipsend,
+		0,
+		0,
+		0
 };
 
 /** \brief Asociación de comando con máximo número de reintentos.
@@ -181,6 +206,9 @@ static const uint8_t maxRetryNumber[AT_COMMAND_SIZE] =
 		2,  /* <= AT+CIPSEND */
 		2,  /* <= AT+CIPSENDEX */
 		1,  /* <= AT+CIPSENDBUF */
+		2,  /* <= AT+GMR */
+		1,  /* <= AT+UART_CUR */
+		1,  /* <= AT+CIPMODE */
 };
 
 /** \brief Asociación de funciones de espera con cada comando.
@@ -196,6 +224,9 @@ static const uint8_t maxRetryNumber[AT_COMMAND_SIZE] =
  * Para acceder a la función de espera de un comando, debe utilizarse su
  * enumerativo como índice, por ejemplo \p waitFunctions[AT_RST].
  *
+ * Corresponden a los tipos SET y EXECUTE; para TEST y QUERY siempre se espera
+ * "OK" o "ERROR" (ver \p getWaitFunction()).
+ *
  */
 static const waitFunction_type waitFunctions[AT_COMMAND_SIZE] = {
 		&rst_wait,  /* <= AT+RST */
@@ -207,7 +238,10 @@ static const waitFunction_type waitFunctions[AT_COMMAND_SIZE] = {
 		&wait_OK_busy_error,    /* <= AT+CIPSERVER */
 		&wait_cipsend,          /* <= AT+CIPSEND */
 		&wait_cipsend,          /* <= AT+CIPSENDEX */
-		&wait_cipsend           /* <= AT+CIPSENDBUF */
+		&wait_cipsend,          /* <= AT+CIPSENDBUF */
+		&wait_gmr,              /* <= AT+GMR */
+		&wait_OK_busy_error,    /* <= AT+UART_CUR */
+		&wait_OK_busy_error     /* <= AT+CIPMODE */
 };
 
 /* Variables para mantener el estado de la cola de comandos */
@@ -215,6 +249,9 @@ static QueuedCommand command_queue[MAX_QUEUED_COMMANDS];
 static uint8_t queue_front = 0;
 static uint8_t queue_count = 0;
 
+/** \brief Cantidad de envíos de datos pendientes por conexión. */
+static uint8_t pendingSends[MAX_MULTIPLE_CONNECTIONS];
+
 /* Buffer circular para guardar los datos a enviar de los comandos */
 static char internalBuffer_data[MAX_SENDBUFFER_SIZE];
 static ciaaLibs_CircBufType circBuffer;
@@ -243,6 +280,15 @@ static Parser parserConnectionOpen = INITIALIZER_AT_CONNECTIONOPEN;
 static Parser parserConnectionFailed = INITIALIZER_AT_CONNECTIONFAILED;
 static Parser parserResetDetection = INITIALIZER_AT_RESET_DETECTION;
 
+/** \brief Parser para la versión del firmware en la respuesta de AT+GMR. */
+static Parser parserGMR = INITIALIZER_AT_GMR;
+
+/** \brief Funcionalidades detectadas del firmware AT, ver \p ESP8266_Capability. */
+static uint8_t capabilities = 0;
+
+/** \brief Versión del firmware AT, ver \p esp8266_getFirmwareVersion(). */
+static uint16_t firmwareVersion = 0;
+
 /** \brief Parsers para capturar cadenas de caracteres. */
 static Parser parserLiteral[3] =
 {
@@ -296,6 +342,11 @@ static int32_t queue_cmd_push(QueuedCommand newCommand)
 		command_queue[(queue_front + queue_count) & (MAX_QUEUED_COMMANDS - 1)] = newCommand;
 		queue_count++;
 		ret = 1;
+
+		if (isSendCommand(newCommand.command) && newCommand.connectionID < MAX_MULTIPLE_CONNECTIONS)
+		{
+			pendingSends[newCommand.connectionID]++;
+		}
 	}
 
 	return ret;
@@ -313,6 +364,17 @@ static QueuedCommand queue_cmd_pop(void){
 	return ret;
 }
 
+/** Debe llamarse cuando un comando extraído con \p queue_cmd_pop() terminó de procesarse,
+ * ya sea que se haya enviado o descartado.
+ */
+static void queue_cmd_finished(const QueuedCommand * cmd)
+{
+	if (isSendCommand(cmd->command) && cmd->connectionID < MAX_MULTIPLE_CONNECTIONS && pendingSends[cmd->connectionID] > 0)
+	{
+		pendingSends[cmd->connectionID]--;
+	}
+}
+
 static uint8_t queue_cmd_isEmpty(void){
 	if (queue_count == 0){
 		return 1;
@@ -417,6 +479,7 @@ static int32_t paramsToString_cipsend(QueuedCommand* cmd, void* parameters){
 
 	if (data->length > 0)
 	{
+		cmd->connectionID = data->connectionID;
 		paramStr[0] = '0' + data->connectionID;
 		uintToString(data->length, 1, (unsigned char *)&paramStr[2]);
 		cmd->paramsData = internalBuffer_writeString(paramStr);
@@ -563,12 +626,97 @@ static WaitResult wait_OK_busy_error(void)
 
 static WaitResult wait_cipsend(void)
 {
-	char * waitString[3] = {"busy p...", "OK\r\n>", "\r\nERROR"};
+	/* Según la versión del firmware, el prompt puede llegar como "OK\r\n>" o "OK\r\n> ",
+	   por lo que sólo se espera el salto de línea previo al prompt */
+	char * waitString[3] = {"busy p...", "\r\n>", "\r\nERROR"};
 	return waitForAny(waitString, 3);
 }
 
+static WaitResult wait_gmr(void)
+{
+	WaitResult ret;
+	PARSER_RESULTS_GMR_T * version;
+
+	/* Mientras se espera el "OK", se captura la versión del firmware AT */
+	parser_init(&parserGMR);
+	cmd_parsers_add(&parserGMR);
+
+	ret = wait_OK_busy_error();
+
+	if (ret == WAIT_RESULT_OK && parser_getStatus(&parserGMR) == STATUS_COMPLETE)
+	{
+		version = parser_getResults(&parserGMR);
+		firmwareVersion = ((uint16_t)version->major << 8) | version->minor;
+
+		if (firmwareVersion >= FIRMWARE_VERSION_SEND_OK)
+		{
+			capabilities |= ESP8266_CAP_SEND_OK;
+		}
+
+		if (firmwareVersion >= FIRMWARE_VERSION_SEGMENT_ID)
+		{
+			capabilities |= ESP8266_CAP_SEGMENT_ID;
+		}
+	}
+
+	return ret;
+}
+
 /*==================[end of wait functions]==================================*/
 
+/*==================[start of probe functions]===============================*/
+
+static void queueProbeCommand(AT_Command command, AT_Type type, uint8_t capability)
+{
+	QueuedCommand newCommand = {0};
+
+	newCommand.command = command;
+	newCommand.type = type;
+	newCommand.contentInfo = CONTENT_EMPTY;
+	newCommand.connectionID = MAX_MULTIPLE_CONNECTIONS;
+	newCommand.capability = capability;
+
+	queue_cmd_push(newCommand);
+}
+
+/** Una vez finalizado el sondeo, elige qué comando enviar realmente en lugar del encolado. */
+static AT_Command resolveCommand(AT_Command command, AT_Type type)
+{
+	if (!hasCapability(ESP8266_CAP_PROBED) || type != AT_TYPE_SET)
+	{
+		return command;
+	}
+
+	if (isSendCommand(command))
+	{
+		/* Todas las variantes reciben los mismos parámetros, se usa la más rápida disponible */
+		if (hasCapability(ESP8266_CAP_CIPSENDBUF))
+		{
+			return AT_CIPSENDBUF;
+		}
+		return (hasCapability(ESP8266_CAP_CIPSENDEX) ? AT_CIPSENDEX : AT_CIPSEND);
+	}
+
+	if (command == AT_CWSAP_CUR && !hasCapability(ESP8266_CAP_CWSAP_CUR))
+	{
+		return AT_CWSAP;
+	}
+
+	return command;
+}
+
+static waitFunction_type getWaitFunction(const QueuedCommand * cmd)
+{
+	if (cmd->type == AT_TYPE_TEST || cmd->type == AT_TYPE_QUERY)
+	{
+		return &wait_OK_busy_error;
+	}
+
+	return waitFunctions[cmd->command];
+}
+
+/*==================[end of probe functions]=================================*/
+
 /*==================[external functions definition]==========================*/
 
 void esp8266_init(void)
@@ -580,6 +728,7 @@ void esp8266_init(void)
 	parser_init(&parserConnectionClose);
 	parser_init(&parserConnectionFailed);
 	parser_init(&parserResetDetection);
+	parser_init(&parserGMR);
 
 	/* open UART connected to RS232 connector */
 	fd_uart = ciaaPOSIX_open("/dev/serial/uart/2", ciaaPOSIX_O_RDWR | ciaaPOSIX_O_NONBLOCK);
@@ -613,6 +762,7 @@ int32_t esp8266_queueCommand(AT_Command command, AT_Type type, void* parameters)
 	newCommand.command = command;
 	newCommand.type = type;
 	newCommand.contentInfo = CONTENT_EMPTY;
+	newCommand.connectionID = MAX_MULTIPLE_CONNECTIONS;
 
 	if (type == AT_TYPE_SET){ /* Sólo los comandos de tipo SET necesitan parámetros al ser llamados */
 		ret = paramsToString[command](&newCommand, parameters);
@@ -633,10 +783,13 @@ void esp8266_doWork(void)
 	uint8_t haveToRetry, retry, buf[16];
 	char * waitStrings[3] = {0};
 	WaitResult result;
+	waitFunction_type waitFunction;
 
 	while(!queue_cmd_isEmpty())
 	{
 		cmd = queue_cmd_pop();
+		cmd.command = resolveCommand(cmd.command, cmd.type);
+		waitFunction = getWaitFunction(&cmd);
 
 		haveToRetry = 1;
 		for (retry = 1; retry <= maxRetryNumber[cmd.command] && haveToRetry; retry++)
@@ -652,15 +805,21 @@ void esp8266_doWork(void)
 			/* Terminador de comando */
 			ciaaPOSIX_write(fd_uart, "\r\n", 2);
 
-			if (isCommandWaitFunctionDefined(cmd.command))
+			if (waitFunction != NULL)
 			{
-				result = waitFunctions[cmd.command]();
+				result = waitFunction();
 				if (result == WAIT_RESULT_BUSY || result == WAIT_RESULT_TIMEOUT)
 				{
 					logger_print_string("Retry...");
 					/* Hubo error al esperar (timeout, etc), por lo cual reintento si es posible */
 					continue;
 				}
+
+				/* Si el comando es parte del sondeo, su respuesta indica si la funcionalidad existe */
+				if (cmd.capability != 0 && result == WAIT_RESULT_OK)
+				{
+					capabilities |= cmd.capability;
+				}
 			}
 
 			/* En teoría el comando ha sido enviado correctamente.
@@ -687,7 +846,19 @@ void esp8266_doWork(void)
 
 				waitStrings[0] = "ERROR"; /* If connection cannot be established, or it’s not a TCP connection, or buffer full, or some other error occurred, returns ERROR */
 				waitStrings[1] = (char*) buf; /* Recv xxxxx byte */
-				waitForAny(waitStrings, 2);
+
+				/* Con AT+CIPSEND y AT+CIPSENDEX el "SEND OK" corresponde a este envío. Con AT+CIPSENDBUF
+				   llega en forma asincrónica por segmentos anteriores (con su número desde el firmware
+				   1.0, ESP8266_CAP_SEGMENT_ID), y no indica que el módulo esté libre */
+				if ((cmd.command == AT_CIPSEND || cmd.command == AT_CIPSENDEX) && hasCapability(ESP8266_CAP_SEND_OK))
+				{
+					waitStrings[2] = "SEND OK";
+					waitForAny(waitStrings, 3);
+				}
+				else
+				{
+					waitForAny(waitStrings, 2);
+				}
 			}
 
 			if (callbackCommandSent != NULL)
@@ -697,7 +868,7 @@ void esp8266_doWork(void)
 
 			/* Terminó correctamente la ejecución del comando, no reintento más */
 			haveToRetry = 0;
-			if (!isCommandWaitFunctionDefined(cmd.command))
+			if (waitFunction == NULL)
 			{
 				/* Si el comando no tiene función de espera para confirmar la finalización de su ejecución,
 				 * se asume un delay.
@@ -713,7 +884,107 @@ void esp8266_doWork(void)
 			logger_print_string("Reset limit excedeed");
 			deleteCommandDataFromBuffer(&cmd);
 		}
+
+		queue_cmd_finished(&cmd);
+	}
+}
+
+
+void esp8266_queueProbe(void)
+{
+	capabilities = 0;
+	firmwareVersion = 0;
+
+	queueProbeCommand(AT_CIPSENDBUF, AT_TYPE_TEST, ESP8266_CAP_CIPSENDBUF);
+	queueProbeCommand(AT_CIPSENDEX, AT_TYPE_TEST, ESP8266_CAP_CIPSENDEX);
+	/* Forma de prueba: la consulta depende del modo WiFi, y en modo estación responde ERROR */
+	queueProbeCommand(AT_CWSAP_CUR, AT_TYPE_TEST, ESP8266_CAP_CWSAP_CUR);
+	queueProbeCommand(AT_UART_CUR, AT_TYPE_QUERY, ESP8266_CAP_UART_CUR);
+	queueProbeCommand(AT_CIPMODE, AT_TYPE_QUERY, ESP8266_CAP_CIPMODE);
+
+	/* AT+GMR va al final: al recibir su respuesta el sondeo se da por finalizado */
+	queueProbeCommand(AT_GMR, AT_TYPE_EXECUTE, ESP8266_CAP_PROBED);
+}
+
+
+uint8_t esp8266_getCapabilities(void)
+{
+	return capabilities;
+}
+
+
+uint16_t esp8266_getFirmwareVersion(void)
+{
+	return firmwareVersion;
+}
+
+
+int32_t esp8266_queueSendParts(uint8_t connectionID, const AT_CIPSEND_PART * parts, uint8_t count)
+{
+	QueuedCommand newCommand = {0};
+	char paramStr[7] = "N,XXXX";
+	uint16_t length = 0;
+	uint16_t written = 0;
+	uint8_t i;
+
+	if (connectionID >= MAX_MULTIPLE_CONNECTIONS)
+	{
+		return -1;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		length += parts[i].length;
+	}
+
+	if (length == 0)
+	{
+		return -1;
+	}
+
+	newCommand.command = AT_CIPSENDBUF;
+	newCommand.type = AT_TYPE_SET;
+	newCommand.connectionID = connectionID;
+
+	paramStr[0] = '0' + connectionID;
+	uintToString(length, 1, (unsigned char *)&paramStr[2]);
+	newCommand.paramsData = internalBuffer_writeString(paramStr);
+	if (!internalBuffer_wasDataWritten(newCommand.paramsData))
+	{
+		return -1;
+	}
+
+	/* Los fragmentos quedan contiguos en el buffer circular, por lo que se envían como un único contenido */
+	for (i = 0; i < count; i++)
+	{
+		if (parts[i].length > 0)
+		{
+			if (internalBuffer_writeData(parts[i].content, parts[i].length) != parts[i].length)
+			{
+				/* No hay lugar en el buffer, se deshace todo lo escrito */
+				ciaaLibs_circBufDeleteLastN(&circBuffer, written + internalBuffer_getWrittenLength(newCommand.paramsData));
+				return -1;
+			}
+			written += parts[i].length;
+		}
+	}
+
+	newCommand.content.internal = written;
+	newCommand.contentInfo = CONTENT_INTERNAL;
+
+	if (queue_cmd_push(newCommand) < 0)
+	{
+		ciaaLibs_circBufDeleteLastN(&circBuffer, written + internalBuffer_getWrittenLength(newCommand.paramsData));
+		return -1;
 	}
+
+	return 1;
+}
+
+
+uint8_t esp8266_getPendingSends(uint8_t connectionID)
+{
+	return (connectionID < MAX_MULTIPLE_CONNECTIONS ? pendingSends[connectionID] : 0);
 }
 
 
@@ -11,207 +11,1589 @@
 #include "encoder.h"
 #include "StringUtils.h"
 #include "debug_logger.h"
+#include "telemetry.h"
+#include "binary_protocol.h"
+#include "trace.h"
+#include "timestamp.h"
+#include "perf.h"
+#include "odometry.h"
+#include "speed_control.h"
+#include "script.h"
+#include "drive.h"
+#include "deadman.h"
+#include "stall.h"
 
 /*==================[macros and definitions]=================================*/
 
+/** \brief Petición HTTP con la que un cliente abre el stream de eventos (SSE) de los encoders. */
+#define SSE_REQUEST				"GET /eventos HTTP/1.1"
+
+/** \brief Longitud de \p SSE_REQUEST, sin contar el carácter nulo. */
+#define SSE_REQUEST_LENGTH		(sizeof(SSE_REQUEST) - 1)
+
+/** \brief Resultado de un comando rechazado porque quien lo envió no controla los motores. */
+#define COMANDO_SIN_CONTROL		(-2)
+
 /*==================[internal data declaration]==============================*/
 
-/*==================[internal functions declaration]=========================*/
+/** \brief Protocolo con el que se comunica cada conexión. */
+typedef enum {
+	PROTOCOLO_ASCII = 0,	/**< Comandos "$...$" y "%...", valor por defecto de toda conexión nueva. */
+	PROTOCOLO_BINARIO = 1	/**< Tramas del protocolo binario, \see binary_protocol.h */
+} Protocolo;
+
+/*==================[internal functions declaration]=========================*/
+
+/** \brief Función de callback para TimeElapsed de Encoder, usada en el modo Control de motores. */
+static void SendStatus(void);
+
+/** \brief Indica si una conexión puede cambiar el estado de los motores o su seguridad: es
+ * quien los controla, o nadie los controla. Mientras se caracteriza, sólo quien lo pidió. */
+static uint8_t PuedeControlar(uint8_t connectionID);
+
+/** \brief Función de callback para TimeElapsed de Encoder, usada en el modo Caracterizar. */
+static void SendDatosCaracterizar(void);
+
+/** \brief Función de callback para cada muestra de Encoder: odometría, guion y control de velocidad. */
+static void ProcesarMuestra(void);
+
+/** \brief Función de callback para DataReceived de ESP8266. */
+static void ReceiveData(ReceivedDataInfo info);
+
+/** \brief Función de callback para ResetDetected de ESP8266. */
+static void WiFiReset(void);
+
+/** \brief Función de callback para ConnectionChanged de ESP8266. */
+static void ConnectionChanged(ConnectionInfo info);
+
+/** \brief Cambia de modo a Caracterizar.
+ *
+ * \param[in] infoPtr Puntero a los parámetros del comando CARACTERIZAR.
+ * \param[in] connectionID ID de conexión de quien envió CARACTERIZAR.
+ *
+ */
+static void ComenzarCaracterizar(PARSER_RESULTS_CARACTERIZAR_T * infoPtr, uint8_t connectionID);
+
+/** \brief Cambia de modo Caracterizar a Control de motores. */
+static void FinalizarCaracterizar(void);
+
+/** \brief Ejecuta un comando reconocido por el parser de comandos genéricos.
+ *
+ * \param[in] cmd Resultados del parser, con el comando y sus argumentos.
+ * \param[in] connectionID ID de conexión de quien envió el comando.
+ *
+ */
+static void ProcesarComando(PARSER_RESULTS_COMANDO_T * cmd, uint8_t connectionID);
+
+/** \brief Ejecuta una trama recibida por una conexión que usa el protocolo binario.
+ *
+ * \param[in] frame Trama recibida, con su CRC ya verificado.
+ * \param[in] connectionID ID de conexión de quien envió la trama.
+ *
+ */
+static void ProcesarTrama(const BinprotoFrame * frame, uint8_t connectionID);
+
+/** \brief Registra un nuevo ciclo de trabajo, si quien lo envía puede controlar los motores.
+ *
+ * El valor se aplica a las salidas PWM al terminar de procesar los datos recibidos.
+ *
+ * \param[in] data Motor, ciclo de trabajo y sentido solicitados.
+ * \param[in] connectionID ID de conexión de quien envió el comando.
+ *
+ */
+static void RegistrarDutyCycle(const MotorControlData * data, uint8_t connectionID);
+
+/** \brief Aplica a las salidas PWM los ciclos de trabajo de los motores marcados en \p lastDutyCycleDirty.
+ *
+ * Además, informa a los encoders de un único canal el sentido de giro de esos motores.
+ * Si no hay motores marcados no hace nada.
+ *
+ */
+static void AplicarDutyCycles(void);
+
+/** \brief Responde el comando PWM con las escrituras de las salidas PWM.
+ *
+ * Envía $PWM=ESCRITURAS,AHORRADAS$: señales escritas, y las que no se escribieron porque
+ * su motor ya tenía ese estado.
+ *
+ * \param[in] connectionID ID de conexión de quien envió el comando.
+ *
+ */
+static int32_t EnviarPwm(uint8_t connectionID);
+
+/** \brief Envía el tiempo sin comandos tras el cual se detienen los motores y la cantidad de detenciones.
+ *
+ * \param[in] connectionID ID de conexión a la que se envía la respuesta.
+ * \return Si es negativo, no se pudo encolar el envío.
+ *
+ */
+static int32_t EnviarDeadman(uint8_t connectionID);
+
+/** \brief Envía la frecuencia de las señales PWM y la cantidad de pasos del ciclo de trabajo.
+ *
+ * \param[in] connectionID ID de conexión a la que se envía la respuesta.
+ * \return Si es negativo, no se pudo encolar el envío.
+ *
+ */
+static int32_t EnviarFrecuencia(uint8_t connectionID);
+
+/** \brief Envía el tiempo muerto de una señal PWM.
+ *
+ * \param[in] connectionID ID de conexión a la que se envía la respuesta.
+ * \param[in] canal Número de señal.
+ * \return Si es negativo, no se pudo encolar el envío.
+ *
+ */
+static int32_t EnviarTiempoMuerto(uint8_t connectionID, uint8_t canal);
+
+/** \brief Envía la configuración de la detección de atascos de un motor y la cantidad de atascos.
+ *
+ * \param[in] connectionID ID de conexión a la que se envía la respuesta.
+ * \param[in] motorID Número de motor.
+ * \return Si es negativo, no se pudo encolar el envío.
+ *
+ */
+static int32_t EnviarAtasco(uint8_t connectionID, uint8_t motorID);
+
+/** \brief Función de callback para los motores cortados por atascados, avisa a quien controla los motores. */
+static void NotificarAtasco(uint8_t motorID);
+
+/** \brief Responde un $PING$. */
+static int32_t EnviarPing(uint8_t connectionID);
+
+/** \brief Envía la cantidad de envíos de telemetría descartados para la conexión.
+ *
+ * \param[in] connectionID ID de conexión a la que se envía la respuesta.
+ * \return Si es negativo, no se pudo encolar el envío.
+ *
+ */
+static int32_t EnviarSuscripcion(uint8_t connectionID);
+
+/** \brief Registra el ciclo de trabajo de todos los motores a la vez, si quien lo envía puede controlarlos.
+ *
+ * Como los valores se aplican al terminar de procesar los datos recibidos con
+ * una única actualización de las salidas PWM, todos los motores cambian juntos.
+ *
+ * \param[in] valores Ciclo de trabajo de cada motor, de -100 a 100; el signo indica el sentido.
+ * \param[in] connectionID ID de conexión de quien envió el comando.
+ * \return Si es negativo, algún valor estaba fuera de rango o la conexión no controla los
+ * motores, y no se registró ninguno.
+ *
+ */
+static int32_t RegistrarMotores(const int32_t * valores, uint8_t connectionID);
+
+/** \brief Fija la velocidad deseada de un motor, si quien la envía puede controlar los motores.
+ *
+ * \param[in] motorID Número de motor.
+ * \param[in] rpm Velocidad en RPM, el signo indica el sentido.
+ * \param[in] connectionID ID de conexión de quien envió el comando.
+ * \return Si es negativo, el motor era inválido o la conexión no controla los motores.
+ *
+ */
+static int32_t RegistrarVelocidad(uint8_t motorID, int32_t rpm, uint8_t connectionID);
+
+/** \brief Carga parte del guion de movimiento.
+ *
+ * \param[in] offset Posición en el guion.
+ * \param[in] palabras Bytecode en palabras de 32 bits, cada una con 4 bytes little-endian.
+ * \param[in] count Cantidad de palabras.
+ * \return Si es negativo, no se pudo cargar (\see script_load()).
+ *
+ */
+static int32_t CargarGuion(int32_t offset, const int32_t * palabras, uint8_t count);
+
+/** \brief Fija la velocidad del robot, si quien la envía puede controlar los motores.
+ *
+ * \param[in] lineal Velocidad lineal en mm/s.
+ * \param[in] angular Velocidad angular en milirradianes/s, positiva en sentido antihorario.
+ * \param[in] connectionID ID de conexión de quien envió el comando.
+ * \return Si es negativo, la conexión no controla los motores.
+ *
+ */
+static int32_t RegistrarDiferencial(int32_t lineal, int32_t angular, uint8_t connectionID);
+
+/** \brief Comienza a ejecutar el guion cargado, si quien lo pide puede controlar los motores.
+ *
+ * \param[in] connectionID ID de conexión de quien envió el comando.
+ * \return Si es negativo, la conexión no controla los motores o el guion era inválido.
+ *
+ */
+static int32_t CorrerGuion(uint8_t connectionID);
+
+/** \brief Responde el comando CORRER con el estado del intérprete de guiones.
+ *
+ * Envía $CORRER=ESTADO,PC,LONGITUD,MUESTRAS$, \see ScriptStatus.
+ *
+ * \param[in] connectionID ID de conexión de quien envió el comando.
+ *
+ */
+static int32_t EnviarGuion(uint8_t connectionID);
+
+/** \brief Cambia el protocolo de una conexión, confirmándolo con una trama MODO.
+ *
+ * \param[in] connectionID ID de conexión.
+ * \param[in] nuevoProtocolo Protocolo a utilizar a partir de ahora.
+ *
+ */
+static void CambiarProtocolo(uint8_t connectionID, Protocolo nuevoProtocolo);
+
+/** \brief Envía un mensaje de error en el protocolo de la conexión.
+ *
+ * \param[in] connectionID ID de conexión.
+ * \param[in] mensaje Mensaje "$ERROR=...$" para las conexiones ASCII, constante.
+ * \param[in] tipoTrama Tipo de trama que causó el error, para las conexiones binarias.
+ *
+ */
+static void EnviarError(uint8_t connectionID, const char * mensaje, uint8_t tipoTrama);
+
+/** \brief Responde el comando PROMEDIO con la velocidad promedio de un encoder.
+ *
+ * \param[in] encoderID Identificador de encoder.
+ * \param[in] ventanaMS Duración de la ventana a promediar.
+ * \param[in] connectionID ID de conexión de quien envió el comando.
+ *
+ */
+static int32_t EnviarPromedio(uint8_t encoderID, uint16_t ventanaMS, uint8_t connectionID);
+
+/** \brief Responde el comando FILTRO con la configuración del filtro de un encoder.
+ *
+ * Envía $FILTRO=ENCODER,US,RECHAZADOS$, con el ancho mínimo de pulso y la cantidad
+ * de flancos descartados desde el inicio.
+ *
+ * \param[in] encoderID Identificador de encoder.
+ * \param[in] connectionID ID de conexión de quien envió el comando.
+ *
+ */
+static int32_t EnviarFiltro(uint8_t encoderID, uint8_t connectionID);
+
+/** \brief Responde el comando POSE con la pose estimada por la odometría.
+ *
+ * Envía $POSE=X,Y,ORIENTACION$, con la posición en milímetros y la orientación
+ * en milirradianes. \see odometry.h
+ *
+ * \param[in] connectionID ID de conexión de quien envió el comando.
+ *
+ */
+static int32_t EnviarPose(uint8_t connectionID);
+
+/** \brief Responde el comando CONTROL con el período del control de velocidad y su jitter.
+ *
+ * Envía $CONTROL=PERIODO_MS,EJECUCIONES,JITTER_PROMEDIO_US,JITTER_MAXIMO_US$.
+ *
+ * \param[in] connectionID ID de conexión de quien envió el comando.
+ *
+ */
+static int32_t EnviarControl(uint8_t connectionID);
+
+/** \brief Responde el comando PREALIMENTACION con la tabla de un motor.
+ *
+ * Envía $PREALIMENTACION=MOTOR,V0,V1,...$, con la velocidad en décimas de RPM para
+ * cada punto de la tabla, o sólo $PREALIMENTACION=MOTOR$ si el motor no tiene una.
+ *
+ * \param[in] connectionID ID de conexión de quien envió el comando.
+ * \param[in] motorID Número de motor.
+ *
+ */
+static int32_t EnviarPrealimentacion(uint8_t connectionID, uint8_t motorID);
+
+/** \brief Responde el comando PERF con el costo de las secciones que recorren todos los motores.
+ *
+ * Envía $PERF=MOTORES,CICLOS_US,N,PROMEDIO,MAXIMO,...$, con una terna por cada
+ * sección de \p PerfSection. Los tiempos están en ciclos de reloj.
+ *
+ * \param[in] connectionID ID de conexión de quien envió el comando.
+ *
+ */
+static int32_t EnviarPerf(uint8_t connectionID);
+
+/** \brief Envía un mensaje ASCII formado por un prefijo y un valor, terminado en '$'.
+ *
+ * \param[in] prefijo Comienzo del mensaje, por ejemplo "$VALOR=", de hasta 20 caracteres.
+ * \param[in] valor Valor a enviar.
+ * \param[in] connectionID ID de conexión.
+ *
+ */
+static int32_t EnviarValor(const char * prefijo, uint32_t valor, uint8_t connectionID);
+
+/** \brief Encola una trama del protocolo binario, copiándola al buffer del módulo WiFi. */
+static int32_t EnviarTrama(uint8_t connectionID, uint8_t tipo, const uint8_t * payload, uint8_t length);
+
+/*==================[internal data definition]===============================*/
+
+/** \brief File descriptor for digital input ports
+ *
+ * Device path /dev/dio/in/0
+ */
+static int32_t fd_in;
+
+/** \brief File descriptor for digital output ports
+ *
+ * Device path /dev/dio/out/0
+ */
+static int32_t fd_out;
+
+/** \brief Buffer de recepción de datos a través del módulo WiFi. */
+static uint8_t receiveBuffer[RECEIVE_BUFFER_LENGTH];
+
+/* Parsers para cada uno de los comandos a capturar */
+static Parser parserDutyCycle = INITIALIZER_DUTYCYCLE;
+static Parser parserCaracterizar = INITIALIZER_CARACTERIZAR;
+static Parser parserCancelarCaracterizar = INITIALIZER_LITERAL_PARSER;
+static Parser parserComando = INITIALIZER_COMANDO;
+
+/** \brief Comandos reconocidos por \p parserComando, en el orden de \p ComandoID. */
+static const char * const comandos[] = {
+		"SUSCRIBIR",
+		"BINARIO",
+		"MOTORES",
+		"MUESTREO",
+		"PROMEDIO",
+		"TRAZA",
+		"PERF",
+		"FILTRO",
+		"OBSERVADOR",
+		"POSE",
+		"VELOCIDAD",
+		"PID",
+		"CONTROL",
+		"PREALIMENTACION",
+		"RAMPA",
+		"PWM",
+		"GUION",
+		"CORRER",
+		"DIFERENCIAL",
+		"GEOMETRIA",
+		"DEADMAN",
+		"PING",
+		"FRECUENCIA",
+		"TIEMPO_MUERTO",
+		"ATASCO"
+};
+
+/** \brief Índices de la tabla \p comandos. */
+typedef enum {
+	COMANDO_SUSCRIBIR = 0,	/**< $SUSCRIBIR=STREAMS,PERIODOS$; $SUSCRIBIR$ responde $SUSCRIBIR=DESCARTES$ */
+	COMANDO_BINARIO,		/**< $BINARIO=1$, la conexión pasa a usar el protocolo binario */
+	COMANDO_MOTORES,		/**< $MOTORES=D0,D1,...$, ciclo de trabajo de todos los motores a la vez */
+	COMANDO_MUESTREO,		/**< $MUESTREO=MS$, período de muestreo de los encoders */
+	COMANDO_PROMEDIO,		/**< $PROMEDIO=ENCODER,VENTANA_MS$, responde $PROMEDIO=ENCODER,VENTANA_MS,RPM$ */
+	COMANDO_TRAZA,			/**< $TRAZA=ENCODERS$ o $TRAZA=ENCODERS,FORMATO$, 0 detiene la traza */
+	COMANDO_PERF,			/**< $PERF$ responde el costo de las secciones medidas, $PERF=0$ reinicia las mediciones */
+	COMANDO_FILTRO,			/**< $FILTRO=ENCODER,US$ configura el filtro de pulsos cortos, $FILTRO=ENCODER$ lo consulta */
+	COMANDO_OBSERVADOR,		/**< $OBSERVADOR=ALFA$, ganancia del observador de velocidad en milésimas */
+	COMANDO_POSE,			/**< $POSE$ responde la pose estimada por la odometría, $POSE=0$ la vuelve al origen */
+	COMANDO_VELOCIDAD,		/**< $VELOCIDAD=MOTOR,RPM$, control de velocidad a lazo cerrado del motor */
+	COMANDO_PID,			/**< $PID=MOTOR,KP,KI,KD$, ganancias del control de velocidad en milésimas */
+	COMANDO_CONTROL,		/**< $CONTROL=MUESTRAS$, período del control de velocidad; $CONTROL$ lo consulta con su jitter */
+	COMANDO_PREALIMENTACION,	/**< $PREALIMENTACION=MOTOR$ consulta la tabla obtenida al caracterizar, $PREALIMENTACION=MOTOR,0$ la descarta */
+	COMANDO_RAMPA,			/**< $RAMPA=MOTOR,ACEL,JERK$, límites de las consignas en RPM o % por segundo (y por segundo al cuadrado); ACEL 0 los quita */
+	COMANDO_PWM,			/**< $PWM$ responde las escrituras de las salidas PWM y las ahorradas por no tener cambios */
+	COMANDO_GUION,			/**< $GUION=OFFSET,W0,...$ carga bytecode del guion, 4 bytes por palabra, \see script.h */
+	COMANDO_CORRER,			/**< $CORRER=1$ ejecuta el guion, $CORRER=0$ lo detiene y apaga los motores, $CORRER$ responde su estado */
+	COMANDO_DIFERENCIAL,	/**< $DIFERENCIAL=MM_S,MRAD_S$, velocidad lineal y angular del robot, \see drive.h */
+	COMANDO_GEOMETRIA,		/**< $GEOMETRIA=DIAMETRO_MM,TROCHA_MM$, geometría de las ruedas para DIFERENCIAL y la odometría */
+	COMANDO_DEADMAN,		/**< $DEADMAN=MS$, tiempo sin comandos tras el cual se detienen los motores (0 no los detiene); $DEADMAN$ responde $DEADMAN=MS,DETENCIONES$ */
+	COMANDO_PING,			/**< $PING$ mantiene viva la conexión de quien controla los motores, responde $PING$ */
+	COMANDO_FRECUENCIA,		/**< $FRECUENCIA=HZ$ de las señales PWM; $FRECUENCIA$ responde $FRECUENCIA=HZ,PASOS$ con los pasos del ciclo de trabajo */
+	COMANDO_TIEMPO_MUERTO,	/**< $TIEMPO_MUERTO=CANAL,NS$ de una señal PWM; $TIEMPO_MUERTO=CANAL$ lo consulta */
+	COMANDO_ATASCO,			/**< $ATASCO=MOTOR,DUTY,MS$ detección de atascos (MS 0 la deshabilita); $ATASCO=MOTOR$ responde $ATASCO=MOTOR,DUTY,MS,ATASCOS$ */
+	COMANDO_COUNT
+} ComandoID;
+
+/** \brief Protocolo de cada conexión. */
+static Protocolo protocolo[MAX_MULTIPLE_CONNECTIONS];
+
+/** \brief Decodificador de tramas binarias de cada conexión. */
+static BinprotoDecoder decoders[MAX_MULTIPLE_CONNECTIONS];
+
+static MotorControlData  lastDutyCycle[MOTOR_COUNT];
+
+/** \brief Máscara de los motores con un ciclo de trabajo nuevo en \p lastDutyCycle, a aplicar. */
+static uint8_t lastDutyCycleDirty = 0;
+
+/** \brief Indica si se está caracterizando actualmente. */
+static uint8_t caracterizando = 0;
+
+/** \brief Datos usados para controlar al motor mientras se está caracterizando. */
+static MotorControlData controlCaracterizar;
+
+/** \brief ID de conexión de quien solicitó la caracterización. */
+static uint8_t caracterizar_connectionID;
+
+/** \brief ID de conexión del usuario que cambió el modo a Control de motores. */
+static uint8_t dutycycle_connectionID = MAX_MULTIPLE_CONNECTIONS;
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+static uint8_t PuedeControlar(uint8_t connectionID)
+{
+	/* Al caracterizar nadie tiene el control de los motores, pero el barrido no se puede tocar */
+	if (caracterizando)
+	{
+		return (connectionID == caracterizar_connectionID);
+	}
+
+	return (dutycycle_connectionID >= MAX_MULTIPLE_CONNECTIONS || dutycycle_connectionID == connectionID);
+}
+
+
+static void apagarMotores(void)
+{
+	uint8_t i;
+
+	script_abort();
+	speedControl_disableAll();
+	deadman_disarm();
+
+	for (i = 0; i < MOTOR_COUNT; i++){
+		lastDutyCycle[i].motorID = i;
+		lastDutyCycle[i].dutyCycle = 0;
+		lastDutyCycleDirty |= (1u << i);
+	}
+
+	AplicarDutyCycles();
+}
+
+static void AplicarDutyCycles(void)
+{
+	MotorControlData data[MOTOR_COUNT];
+	uint8_t count = 0;
+	uint8_t i;
+
+	if (lastDutyCycleDirty == 0)
+	{
+		return;
+	}
+
+	for (i = 0; i < MOTOR_COUNT; i++)
+	{
+		if (lastDutyCycleDirty & (1u << i))
+		{
+			data[count++] = lastDutyCycle[i];
+			encoder_setDirectionHint(i, (lastDutyCycle[i].direction == DIR_FORWARD ? 1 : -1));
+		}
+	}
+	lastDutyCycleDirty = 0;
+
+	ciaaPWM_updateMotors(data, count);
+}
+
+
+static void ProcesarMuestra(void)
+{
+	ciaaPWM_applyConfig(); /* Antes de cualquier escritura de las salidas PWM en esta muestra */
+	odometry_update();
+	deadman_update(); /* Antes del guion y del control, que pueden tomar su detención en esta muestra */
+	stall_update();
+	script_update(); /* Antes del control, que aplica sus consignas en la misma muestra */
+	speedControl_update();
+}
+
+
+static void SendStatus(void)
+{
+	uint8_t controllerID = MAX_MULTIPLE_CONNECTIONS;
+
+    /* Se comprueba que un usuario haya enviado un comando DUTYCYCLE, y que su conexión siga abierta */
+	if (dutycycle_connectionID < MAX_MULTIPLE_CONNECTIONS && esp8266_getConnectionStatus(dutycycle_connectionID) == CONNECTION_STATUS_OPEN)
+	{
+		controllerID = dutycycle_connectionID;
+	}
+
+	telemetry_publish(controllerID);
+}
+
+
+static void ComenzarCaracterizar(PARSER_RESULTS_CARACTERIZAR_T * infoPtr, uint8_t connectionID)
+{
+	if (infoPtr->idMotor >= MOTOR_COUNT)
+	{
+		EnviarError(connectionID, "$ERROR=MOTOR fuera de rango.$", BINPROTO_MSG_CARACTERIZAR);
+	}
+	else if (infoPtr->tiempo <= 10000)
+	{
+	    /* Deshabilito el callback de Encoder porque voy a reconfigurarlo */
+		encoder_setTimeElapsedCallback(0);
+
+        caracterizando = 1;
+
+        /* El motor a caracterizar se maneja a lazo abierto */
+		script_abort();
+		speedControl_disableAll();
+		deadman_disarm();
+
+		/* Con ciclos de trabajo bajos el motor puede no moverse, sin estar atascado */
+		stall_suspend(1);
+
+		caracterizar_connectionID = connectionID;
+
+        /* Configuro el primer estado para el motor a caracterizar */
+		controlCaracterizar.direction = DIR_FORWARD;
+		controlCaracterizar.dutyCycle = 0;
+		controlCaracterizar.motorID = infoPtr->idMotor;
+
+		ciaaPWM_updateMotor(controlCaracterizar);
+		encoder_setDirectionHint(controlCaracterizar.motorID, 1);
+
+		encoder_beginCount(infoPtr->tiempo);
+		encoder_setTimeElapsedCallback(SendDatosCaracterizar);
+
+		dutycycle_connectionID = MAX_MULTIPLE_CONNECTIONS;
+	}
+	else
+	{
+		EnviarError(connectionID, "$ERROR=TIEMPO fuera de rango.$", BINPROTO_MSG_CARACTERIZAR);
+	}
+}
+
+
+static void FinalizarCaracterizar(void)
+{
+	encoder_setTimeElapsedCallback(0);
+	caracterizando = 0;
+	encoder_beginCount(1000);
+	encoder_setTimeElapsedCallback(SendStatus);
+
+	apagarMotores();
+	stall_suspend(0);
+}
+
+
+static void SendDatosCaracterizar(void)
+{
+	uint8_t buffer[] = "$MOTOR=IDMOTOR,DUTYCYCLE,CANTINTERRUPCIONES$";
+	unsigned char * ptr;
+	uint32_t cuenta;
+	AT_CIPSEND_DATA cipsend_data;
+
+	if (protocolo[caracterizar_connectionID] == PROTOCOLO_BINARIO)
+	{
+		buffer[0] = controlCaracterizar.motorID;
+		buffer[1] = controlCaracterizar.dutyCycle;
+		cuenta = encoder_getLastCount(controlCaracterizar.motorID);
+		binproto_putU16(&buffer[2], (cuenta > USHORT_MAX ? USHORT_MAX : cuenta));
+		EnviarTrama(caracterizar_connectionID, BINPROTO_MSG_DATOS_CARACTERIZAR, buffer, 4);
+	}
+	else
+	{
+		cipsend_data.connectionID = caracterizar_connectionID;
+		cipsend_data.content = (char *)buffer;
+		cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_COPYTOBUFFER;
+
+		ptr = uintToString(controlCaracterizar.motorID, 1, &(buffer[7]));
+		*ptr++ = ',';
+		ptr = uintToString(controlCaracterizar.dutyCycle, 1, ptr);
+		*ptr++ = ',';
+		ptr = uintToString(encoder_getLastCount(controlCaracterizar.motorID), 1, ptr);
+		*ptr++ = '$';
+		*ptr = '\0';
+
+		cipsend_data.length = AT_CIPSEND_ZERO_TERMINATED_CONTENT; /* Dejo que el comando calcule internamente la longitud */
+		esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
+	}
+
+	/* La curva medida queda como tabla de prealimentación del control de velocidad */
+	speedControl_recordCharacterization(controlCaracterizar.motorID, controlCaracterizar.dutyCycle,
+			encoder_getSpeed(controlCaracterizar.motorID, SPEED_TYPE_EDGE_TIMED));
+
+	if (controlCaracterizar.dutyCycle < 100)
+	{
+		controlCaracterizar.dutyCycle++;
+		ciaaPWM_updateMotor(controlCaracterizar);
+		encoder_resetCount();
+	}
+	else
+	{
+		if (protocolo[caracterizar_connectionID] == PROTOCOLO_BINARIO)
+		{
+			EnviarTrama(caracterizar_connectionID, BINPROTO_MSG_FIN_CARACTERIZAR, 0, 0);
+		}
+		else
+		{
+			cipsend_data.connectionID = caracterizar_connectionID;
+			cipsend_data.content = "$FIN_CARACTERIZAR$";
+			cipsend_data.length = 18;
+			cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_DONT_COPY;
+
+			esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
+		}
+
+		FinalizarCaracterizar();
+	}
+
+}
+
+static void ProcesarComando(PARSER_RESULTS_COMANDO_T * cmd, uint8_t connectionID)
+{
+	int32_t valores[MOTOR_COUNT];
+	int32_t ret = -1;
+	uint8_t i;
+
+	switch (cmd->commandIndex)
+	{
+	case COMANDO_SUSCRIBIR:
+		/* $SUSCRIBIR=STREAMS$ o $SUSCRIBIR=STREAMS,PERIODOS$, STREAMS = 0 elimina la suscripción */
+		if (cmd->argCount == 0)
+		{
+			ret = EnviarSuscripcion(connectionID);
+		}
+		else if (cmd->argCount >= 1 && cmd->args[0] == 0)
+		{
+			telemetry_unsubscribe(connectionID);
+			ret = 1;
+		}
+		else if (cmd->argCount >= 1 && cmd->args[0] > 0 && cmd->args[0] <= TELEMETRY_STREAM_ALL &&
+				(cmd->argCount == 1 || (cmd->args[1] > 0 && cmd->args[1] <= UCHAR_MAX)))
+		{
+			ret = telemetry_subscribe(connectionID, cmd->args[0], (cmd->argCount == 1 ? 1 : cmd->args[1]), TELEMETRY_FORMAT_ASCII);
+		}
+		break;
+	case COMANDO_MOTORES:
+		/* Mismo formato que el comando '%': de 0 a 200, 100 es detenido, más de 100 hacia adelante */
+		if (cmd->argCount == MOTOR_COUNT && !caracterizando)
+		{
+			for (i = 0; i < MOTOR_COUNT; i++)
+			{
+				valores[i] = cmd->args[i] - 100;
+			}
+			ret = RegistrarMotores(valores, connectionID);
+		}
+		break;
+	case COMANDO_MUESTREO:
+		if (cmd->argCount == 1 && cmd->args[0] > 0 && cmd->args[0] <= ENCODER_MAX_SAMPLE_PERIOD_MS)
+		{
+			ret = (PuedeControlar(connectionID) ? encoder_setSamplePeriod(cmd->args[0]) : COMANDO_SIN_CONTROL);
+		}
+		break;
+	case COMANDO_PROMEDIO:
+		if (cmd->argCount == 2 && cmd->args[0] >= 0 && cmd->args[0] < ENCODER_COUNT &&
+				cmd->args[1] > 0 && cmd->args[1] <= USHORT_MAX)
+		{
+			ret = EnviarPromedio(cmd->args[0], cmd->args[1], connectionID);
+		}
+		break;
+	case COMANDO_TRAZA:
+		/* ENCODERS es una máscara; FORMATO 0 es ASCII (por defecto) y 1 tramas binarias */
+		if (cmd->argCount >= 1 && cmd->args[0] == 0)
+		{
+			trace_stop();
+			ret = 1;
+		}
+		else if ((cmd->argCount == 1 || (cmd->argCount == 2 && (cmd->args[1] == TRACE_FORMAT_ASCII || cmd->args[1] == TRACE_FORMAT_BINARY))) &&
+				cmd->args[0] > 0 && cmd->args[0] <= UCHAR_MAX)
+		{
+			ret = trace_start(connectionID, cmd->args[0], (cmd->argCount == 2 ? cmd->args[1] : TRACE_FORMAT_ASCII));
+			if (ret >= 0)
+			{
+				/* Se informa la unidad de los tiempos de la traza */
+				EnviarValor("$TRAZA_CICLOS_US=", timestamp_cyclesPerMicrosecond(), connectionID);
+			}
+		}
+		break;
+	case COMANDO_PERF:
+		if (cmd->argCount == 0)
+		{
+			ret = EnviarPerf(connectionID);
+		}
+		else if (cmd->argCount == 1 && cmd->args[0] == 0)
+		{
+			perf_reset();
+			ret = 1;
+		}
+		break;
+	case COMANDO_FILTRO:
+		if (cmd->argCount == 2 && cmd->args[0] >= 0 && cmd->args[0] < ENCODER_COUNT &&
+				cmd->args[1] >= 0 && cmd->args[1] <= USHORT_MAX)
+		{
+			ret = (PuedeControlar(connectionID) ? encoder_setGlitchFilter(cmd->args[0], cmd->args[1]) : COMANDO_SIN_CONTROL);
+		}
+		else if (cmd->argCount == 1 && cmd->args[0] >= 0 && cmd->args[0] < ENCODER_COUNT)
+		{
+			ret = EnviarFiltro(cmd->args[0], connectionID);
+		}
+		break;
+	case COMANDO_OBSERVADOR:
+		if (cmd->argCount == 1 && cmd->args[0] > 0 && cmd->args[0] < 1000)
+		{
+			ret = (PuedeControlar(connectionID) ? encoder_setObserverGain(cmd->args[0]) : COMANDO_SIN_CONTROL);
+		}
+		break;
+	case COMANDO_POSE:
+		if (cmd->argCount == 0)
+		{
+			ret = EnviarPose(connectionID);
+		}
+		else if (cmd->argCount == 1 && cmd->args[0] == 0)
+		{
+			odometry_reset();
+			ret = 1;
+		}
+		break;
+	case COMANDO_VELOCIDAD:
+		if (cmd->argCount == 2 && cmd->args[0] >= 0 && cmd->args[0] < MOTOR_COUNT &&
+				cmd->args[1] >= -SPEED_CONTROL_MAX_RPM && cmd->args[1] <= SPEED_CONTROL_MAX_RPM && !caracterizando)
+		{
+			ret = RegistrarVelocidad(cmd->args[0], cmd->args[1], connectionID);
+		}
+		break;
+	case COMANDO_PID:
+		if (cmd->argCount == 4 && cmd->args[0] >= 0 && cmd->args[0] < MOTOR_COUNT &&
+				cmd->args[1] >= 0 && cmd->args[1] <= USHORT_MAX &&
+				cmd->args[2] >= 0 && cmd->args[2] <= USHORT_MAX &&
+				cmd->args[3] >= 0 && cmd->args[3] <= USHORT_MAX)
+		{
+			ret = (PuedeControlar(connectionID) ?
+					speedControl_setGains(cmd->args[0], cmd->args[1], cmd->args[2], cmd->args[3]) : COMANDO_SIN_CONTROL);
+		}
+		break;
+	case COMANDO_CONTROL:
+		if (cmd->argCount == 0)
+		{
+			ret = EnviarControl(connectionID);
+		}
+		else if (cmd->argCount == 1 && cmd->args[0] > 0 && cmd->args[0] <= USHORT_MAX)
+		{
+			ret = (PuedeControlar(connectionID) ? speedControl_setDivider(cmd->args[0]) : COMANDO_SIN_CONTROL);
+		}
+		break;
+	case COMANDO_DIFERENCIAL:
+		if (cmd->argCount == 2 && !caracterizando)
+		{
+			ret = RegistrarDiferencial(cmd->args[0], cmd->args[1], connectionID);
+		}
+		break;
+	case COMANDO_GEOMETRIA:
+		if (cmd->argCount == 2 && cmd->args[0] > 0 && cmd->args[0] <= USHORT_MAX &&
+				cmd->args[1] > 0 && cmd->args[1] <= USHORT_MAX)
+		{
+			ret = (PuedeControlar(connectionID) ? drive_setGeometry(cmd->args[0], cmd->args[1]) : COMANDO_SIN_CONTROL);
+		}
+		break;
+	case COMANDO_GUION:
+		if (cmd->argCount >= 2)
+		{
+			ret = (PuedeControlar(connectionID) ? CargarGuion(cmd->args[0], &cmd->args[1], cmd->argCount - 1) : COMANDO_SIN_CONTROL);
+		}
+		break;
+	case COMANDO_CORRER:
+		if (cmd->argCount == 0)
+		{
+			ret = EnviarGuion(connectionID);
+		}
+		else if (cmd->argCount == 1 && cmd->args[0] == 1 && !caracterizando)
+		{
+			ret = CorrerGuion(connectionID);
+		}
+		else if (cmd->argCount == 1 && cmd->args[0] == 0)
+		{
+			ret = COMANDO_SIN_CONTROL;
+			if (PuedeControlar(connectionID))
+			{
+				apagarMotores();
+				ret = 1;
+			}
+		}
+		break;
+	case COMANDO_PWM:
+		if (cmd->argCount == 0)
+		{
+			ret = EnviarPwm(connectionID);
+		}
+		break;
+	case COMANDO_DEADMAN:
+		if (cmd->argCount == 0)
+		{
+			ret = EnviarDeadman(connectionID);
+		}
+		else if (cmd->argCount == 1 && cmd->args[0] >= 0 && cmd->args[0] <= USHORT_MAX)
+		{
+			ret = COMANDO_SIN_CONTROL;
+			if (PuedeControlar(connectionID))
+			{
+				deadman_setTimeout(cmd->args[0]);
+				ret = 1;
+			}
+		}
+		break;
+	case COMANDO_FRECUENCIA:
+		if (cmd->argCount == 0)
+		{
+			ret = EnviarFrecuencia(connectionID);
+		}
+		else if (cmd->argCount == 1 && cmd->args[0] > 0)
+		{
+			ret = (PuedeControlar(connectionID) ? ciaaPWM_setFrequency(cmd->args[0]) : COMANDO_SIN_CONTROL);
+		}
+		break;
+	case COMANDO_TIEMPO_MUERTO:
+		if (cmd->argCount == 1 && cmd->args[0] >= 0 && cmd->args[0] < BOARD_PWM_CHANNEL_COUNT)
+		{
+			ret = EnviarTiempoMuerto(connectionID, cmd->args[0]);
+		}
+		else if (cmd->argCount == 2 && cmd->args[0] >= 0 && cmd->args[0] < BOARD_PWM_CHANNEL_COUNT &&
+				cmd->args[1] >= 0 && cmd->args[1] <= USHORT_MAX)
+		{
+			ret = (PuedeControlar(connectionID) ? ciaaPWM_setDeadTime(cmd->args[0], cmd->args[1]) : COMANDO_SIN_CONTROL);
+		}
+		break;
+	case COMANDO_ATASCO:
+		if (cmd->argCount == 1 && cmd->args[0] >= 0 && cmd->args[0] < MOTOR_COUNT)
+		{
+			ret = EnviarAtasco(connectionID, cmd->args[0]);
+		}
+		else if (cmd->argCount == 3 && cmd->args[0] >= 0 && cmd->args[0] < MOTOR_COUNT &&
+				cmd->args[1] > 0 && cmd->args[1] <= 100 && cmd->args[2] >= 0 && cmd->args[2] <= USHORT_MAX)
+		{
+			ret = (PuedeControlar(connectionID) ? stall_configure(cmd->args[0], cmd->args[1], cmd->args[2]) : COMANDO_SIN_CONTROL);
+		}
+		break;
+	case COMANDO_PING:
+		/* ReceiveData ya mantuvo viva la conexión, sólo se responde */
+		if (cmd->argCount == 0)
+		{
+			ret = EnviarPing(connectionID);
+		}
+		break;
+	case COMANDO_RAMPA:
+		if (cmd->argCount == 3 && cmd->args[0] >= 0 && cmd->args[0] < MOTOR_COUNT &&
+				cmd->args[1] >= 0 && cmd->args[1] <= USHORT_MAX &&
+				cmd->args[2] >= 0 && cmd->args[2] <= USHORT_MAX)
+		{
+			ret = (PuedeControlar(connectionID) ? speedControl_setLimits(cmd->args[0], cmd->args[1], cmd->args[2]) : COMANDO_SIN_CONTROL);
+		}
+		break;
+	case COMANDO_PREALIMENTACION:
+		if (cmd->argCount == 1 && cmd->args[0] >= 0 && cmd->args[0] < MOTOR_COUNT)
+		{
+			ret = EnviarPrealimentacion(connectionID, cmd->args[0]);
+		}
+		else if (cmd->argCount == 2 && cmd->args[0] >= 0 && cmd->args[0] < MOTOR_COUNT && cmd->args[1] == 0)
+		{
+			ret = (PuedeControlar(connectionID) ? speedControl_clearFeedForward(cmd->args[0]) : COMANDO_SIN_CONTROL);
+		}
+		break;
+	case COMANDO_BINARIO:
+		/* $BINARIO=1$: a partir de la confirmación, la conexión sólo envía y recibe tramas binarias */
+		if (cmd->argCount == 1 && cmd->args[0] == 1)
+		{
+			CambiarProtocolo(connectionID, PROTOCOLO_BINARIO);
+			ret = 1;
+		}
+		break;
+	default:
+		break;
+	}
+
+	if (ret == COMANDO_SIN_CONTROL)
+	{
+		EnviarError(connectionID, "$ERROR=Otro usuario controla los motores.$", 0);
+	}
+	else if (ret < 0)
+	{
+		EnviarError(connectionID, "$ERROR=Parametros invalidos.$", 0);
+	}
+}
+
+
+static void ProcesarTrama(const BinprotoFrame * frame, uint8_t connectionID)
+{
+	PARSER_RESULTS_CARACTERIZAR_T caracterizar;
+	MotorControlData dutyCycle;
+	int32_t valores[MOTOR_COUNT];
+	int8_t valor;
+	int32_t ret = -1;
+	uint8_t i;
+
+	switch (frame->type)
+	{
+	case BINPROTO_MSG_DUTYCYCLE:
+		/* Motor (u8) y ciclo de trabajo con signo (i8): el signo indica el sentido de giro */
+		if (frame->length == 2 && !caracterizando)
+		{
+			valor = (int8_t)frame->payload[1];
+			if (valor >= -100 && valor <= 100)
+			{
+				dutyCycle.motorID = frame->payload[0];
+				dutyCycle.dutyCycle = (valor < 0 ? -valor : valor);
+				dutyCycle.direction = (valor < 0 ? DIR_BACKWARD : DIR_FORWARD);
+				RegistrarDutyCycle(&dutyCycle, connectionID);
+				ret = 1;
+			}
+		}
+		break;
+	case BINPROTO_MSG_MOTORES:
+		if (frame->length == MOTOR_COUNT && !caracterizando)
+		{
+			for (i = 0; i < MOTOR_COUNT; i++)
+			{
+				valores[i] = (int8_t)frame->payload[i];
+			}
+			ret = RegistrarMotores(valores, connectionID);
+		}
+		break;
+	case BINPROTO_MSG_DIFERENCIAL:
+		if (frame->length == 4 && !caracterizando)
+		{
+			ret = RegistrarDiferencial((int16_t)binproto_getU16(frame->payload), (int16_t)binproto_getU16(&frame->payload[2]), connectionID);
+		}
+		break;
+	case BINPROTO_MSG_PING:
+		ret = 1;
+		break;
+	case BINPROTO_MSG_CARACTERIZAR:
+		if (frame->length == 3 && !caracterizando)
+		{
+			caracterizar.idMotor = frame->payload[0];
+			caracterizar.tiempo = binproto_getU16(&frame->payload[1]);
+			ComenzarCaracterizar(&caracterizar, connectionID);
+			ret = 1;
+		}
+		break;
+	case BINPROTO_MSG_CANCELAR_CARACTERIZAR:
+		if (caracterizando)
+		{
+			FinalizarCaracterizar();
+		}
+		ret = 1;
+		break;
+	case BINPROTO_MSG_SUSCRIBIR:
+		/* Streams (u8) y períodos entre envíos (u8), streams = 0 elimina la suscripción */
+		if (frame->length == 2 && frame->payload[0] == 0)
+		{
+			telemetry_unsubscribe(connectionID);
+			ret = 1;
+		}
+		else if (frame->length == 2)
+		{
+			ret = telemetry_subscribe(connectionID, frame->payload[0], frame->payload[1], TELEMETRY_FORMAT_BINARY);
+		}
+		break;
+	case BINPROTO_MSG_MODO:
+		if (frame->length == 1 && frame->payload[0] <= PROTOCOLO_BINARIO)
+		{
+			CambiarProtocolo(connectionID, frame->payload[0]);
+			ret = 1;
+		}
+		break;
+	default:
+		break;
+	}
+
+	if (ret < 0)
+	{
+		EnviarError(connectionID, 0, frame->type);
+	}
+}
+
+
+static void RegistrarDutyCycle(const MotorControlData * data, uint8_t connectionID)
+{
+	/* Si no hay ningún usuario controlando los motores... */
+	if (dutycycle_connectionID >= MAX_MULTIPLE_CONNECTIONS)
+	{
+		/* ... entonces quien envió este comando los controlará */
+		dutycycle_connectionID = connectionID;
+	}
+
+	/* Verifico que el usuario que envío el comando sea quien controla los motores, y que el
+	   identificador del motor sea válido */
+	if (dutycycle_connectionID == connectionID && data->motorID < MOTOR_COUNT)
+	{
+		/* Un comando manual tiene prioridad sobre el guion en ejecución */
+		script_abort();
+
+		if (speedControl_hasLimits(data->motorID))
+		{
+			/* El ciclo de trabajo se alcanza con una rampa, desde EncoderTask */
+			speedControl_setDutyCycle(data->motorID,
+					(data->direction == DIR_FORWARD ? (int8_t)data->dutyCycle : -(int8_t)data->dutyCycle));
+		}
+		else
+		{
+			lastDutyCycle[data->motorID] = *data;
+			lastDutyCycleDirty |= (1u << data->motorID);
+
+			/* El motor pasa a lazo abierto */
+			speedControl_disable(data->motorID);
+		}
+	}
+}
+
+
+static int32_t RegistrarVelocidad(uint8_t motorID, int32_t rpm, uint8_t connectionID)
+{
+	/* Mismas reglas que para el ciclo de trabajo: el primero en enviarlo controla los motores */
+	if (dutycycle_connectionID >= MAX_MULTIPLE_CONNECTIONS)
+	{
+		dutycycle_connectionID = connectionID;
+	}
+
+	if (dutycycle_connectionID != connectionID)
+	{
+		return COMANDO_SIN_CONTROL;
+	}
+
+	script_abort();
+
+	return speedControl_setSetpoint(motorID, rpm);
+}
+
+
+static int32_t RegistrarDiferencial(int32_t lineal, int32_t angular, uint8_t connectionID)
+{
+	/* Mismas reglas que para el ciclo de trabajo: el primero en enviarlo controla los motores */
+	if (dutycycle_connectionID >= MAX_MULTIPLE_CONNECTIONS)
+	{
+		dutycycle_connectionID = connectionID;
+	}
+
+	if (dutycycle_connectionID != connectionID)
+	{
+		return COMANDO_SIN_CONTROL;
+	}
+
+	script_abort();
+
+	return drive_setVelocity(lineal, angular);
+}
+
+
+static int32_t CargarGuion(int32_t offset, const int32_t * palabras, uint8_t count)
+{
+	uint8_t bytes[COMANDO_MAX_ARGS * 4];
+	uint8_t i;
+
+	if (offset < 0 || offset > USHORT_MAX)
+	{
+		return -1;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		binproto_putU32(&bytes[i * 4], (uint32_t)palabras[i]);
+	}
+
+	return script_load(offset, bytes, count * 4);
+}
+
+
+static int32_t CorrerGuion(uint8_t connectionID)
+{
+	/* Mismas reglas que para el ciclo de trabajo: el primero en enviarlo controla los motores */
+	if (dutycycle_connectionID >= MAX_MULTIPLE_CONNECTIONS)
+	{
+		dutycycle_connectionID = connectionID;
+	}
+
+	if (dutycycle_connectionID != connectionID)
+	{
+		return COMANDO_SIN_CONTROL;
+	}
+
+	return script_start();
+}
+
+
+static int32_t RegistrarMotores(const int32_t * valores, uint8_t connectionID)
+{
+	MotorControlData data;
+	uint8_t motores[MOTOR_COUNT];
+	int8_t duties[MOTOR_COUNT];
+	uint8_t conLimites = 0;
+	uint8_t i;
+
+	for (i = 0; i < MOTOR_COUNT; i++)
+	{
+		if (valores[i] < -100 || valores[i] > 100)
+		{
+			return -1;
+		}
+
+		conLimites |= speedControl_hasLimits(i);
+	}
+
+	/* Mismas reglas que para el ciclo de trabajo: el primero en enviarlo controla los motores */
+	if (dutycycle_connectionID >= MAX_MULTIPLE_CONNECTIONS)
+	{
+		dutycycle_connectionID = connectionID;
+	}
+
+	if (dutycycle_connectionID != connectionID)
+	{
+		return COMANDO_SIN_CONTROL;
+	}
+
+	if (conLimites)
+	{
+		/* Todos pasan por el control de velocidad, así los motores con y sin rampa
+		   cambian en la misma muestra; los que no tienen límites saltan al valor */
+		script_abort();
+
+		for (i = 0; i < MOTOR_COUNT; i++)
+		{
+			motores[i] = i;
+			duties[i] = (int8_t)valores[i];
+		}
+
+		return speedControl_setDutyCycles(motores, duties, MOTOR_COUNT);
+	}
+
+	for (i = 0; i < MOTOR_COUNT; i++)
+	{
+		data.motorID = i;
+		data.dutyCycle = (valores[i] < 0 ? -valores[i] : valores[i]);
+		data.direction = (valores[i] < 0 ? DIR_BACKWARD : DIR_FORWARD);
+		RegistrarDutyCycle(&data, connectionID);
+	}
+
+	return 1;
+}
+
+
+static void CambiarProtocolo(uint8_t connectionID, Protocolo nuevoProtocolo)
+{
+	uint8_t modo = nuevoProtocolo;
+
+	/* La confirmación siempre es una trama, así el cliente sabe desde dónde interpretar el nuevo protocolo */
+	EnviarTrama(connectionID, BINPROTO_MSG_MODO, &modo, 1);
+
+	protocolo[connectionID] = nuevoProtocolo;
+	binproto_initDecoder(&decoders[connectionID]);
+	telemetry_setFormat(connectionID, (nuevoProtocolo == PROTOCOLO_BINARIO ? TELEMETRY_FORMAT_BINARY : TELEMETRY_FORMAT_ASCII));
+}
+
+
+static void EnviarError(uint8_t connectionID, const char * mensaje, uint8_t tipoTrama)
+{
+	AT_CIPSEND_DATA cipsend_data;
+
+	if (protocolo[connectionID] == PROTOCOLO_BINARIO)
+	{
+		EnviarTrama(connectionID, BINPROTO_MSG_ERROR, &tipoTrama, 1);
+	}
+	else if (mensaje != 0)
+	{
+		cipsend_data.connectionID = connectionID;
+		cipsend_data.content = mensaje;
+		cipsend_data.length = AT_CIPSEND_ZERO_TERMINATED_CONTENT;
+		cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_DONT_COPY;
+		esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
+	}
+}
+
+
+static int32_t EnviarPromedio(uint8_t encoderID, uint16_t ventanaMS, uint8_t connectionID)
+{
+	uint8_t buffer[] = "$PROMEDIO=E,VENTANA,-RPMRPMRPM$";
+	unsigned char * ptr;
+	int32_t rpm = encoder_getWindowSpeed(encoderID, ventanaMS, SPEED_TYPE_RPM);
+	AT_CIPSEND_DATA cipsend_data;
+
+	ptr = uintToString(encoderID, 1, &(buffer[10]));
+	*ptr++ = ',';
+	ptr = uintToString(ventanaMS, 1, ptr);
+	*ptr++ = ',';
+	if (rpm < 0)
+	{
+		*ptr++ = '-';
+		rpm = -rpm;
+	}
+	ptr = uintToString(rpm, 1, ptr);
+	*ptr++ = '$';
+	*ptr = '\0';
+
+	cipsend_data.connectionID = connectionID;
+	cipsend_data.content = (char *)buffer;
+	cipsend_data.length = AT_CIPSEND_ZERO_TERMINATED_CONTENT;
+	cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_COPYTOBUFFER;
+
+	return esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
+}
+
+
+static int32_t EnviarFiltro(uint8_t encoderID, uint8_t connectionID)
+{
+	uint8_t buffer[] = "$FILTRO=E,USUSU,RECHAZADOSR$";
+	unsigned char * ptr;
+	AT_CIPSEND_DATA cipsend_data;
+
+	ptr = uintToString(encoderID, 1, &(buffer[8]));
+	*ptr++ = ',';
+	ptr = uintToString(encoder_getGlitchFilter(encoderID), 1, ptr);
+	*ptr++ = ',';
+	ptr = uintToString(encoder_getRejectedEdges(encoderID), 1, ptr);
+	*ptr++ = '$';
+	*ptr = '\0';
+
+	cipsend_data.connectionID = connectionID;
+	cipsend_data.content = (char *)buffer;
+	cipsend_data.length = AT_CIPSEND_ZERO_TERMINATED_CONTENT;
+	cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_COPYTOBUFFER;
+
+	return esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
+}
+
+
+static int32_t EnviarPose(uint8_t connectionID)
+{
+	uint8_t buffer[] = "$POSE=-XXXXXXXXXX,-YYYYYYYYYY,HHHHH$";
+	unsigned char * ptr = &(buffer[6]);
+	OdometryPose pose;
+	AT_CIPSEND_DATA cipsend_data;
+
+	odometry_getPose(&pose);
+
+	if (pose.xMM < 0)
+	{
+		*ptr++ = '-';
+		pose.xMM = -pose.xMM;
+	}
+	ptr = uintToString(pose.xMM, 1, ptr);
+	*ptr++ = ',';
+	if (pose.yMM < 0)
+	{
+		*ptr++ = '-';
+		pose.yMM = -pose.yMM;
+	}
+	ptr = uintToString(pose.yMM, 1, ptr);
+	*ptr++ = ',';
+	ptr = uintToString(pose.headingMrad, 1, ptr);
+	*ptr++ = '$';
+	*ptr = '\0';
+
+	cipsend_data.connectionID = connectionID;
+	cipsend_data.content = (char *)buffer;
+	cipsend_data.length = AT_CIPSEND_ZERO_TERMINATED_CONTENT;
+	cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_COPYTOBUFFER;
+
+	return esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
+}
+
+
+static int32_t EnviarControl(uint8_t connectionID)
+{
+	uint8_t buffer[] = "$CONTROL=PERIO,EJECUCIONES,JITTERPROM,JITTERMAXI$";
+	unsigned char * ptr;
+	SpeedControlTiming timing;
+	AT_CIPSEND_DATA cipsend_data;
+
+	speedControl_getTiming(&timing);
+
+	ptr = uintToString(timing.periodMS, 1, &(buffer[9]));
+	*ptr++ = ',';
+	ptr = uintToString(timing.count, 1, ptr);
+	*ptr++ = ',';
+	ptr = uintToString(timing.averageJitterUS, 1, ptr);
+	*ptr++ = ',';
+	ptr = uintToString(timing.maxJitterUS, 1, ptr);
+	*ptr++ = '$';
+	*ptr = '\0';
+
+	cipsend_data.connectionID = connectionID;
+	cipsend_data.content = (char *)buffer;
+	cipsend_data.length = AT_CIPSEND_ZERO_TERMINATED_CONTENT;
+	cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_COPYTOBUFFER;
+
+	return esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
+}
 
-/** \brief Función de callback para TimeElapsed de Encoder, usada en el modo Control de motores. */
-static void SendStatus(void);
 
-/** \brief Función de callback para TimeElapsed de Encoder, usada en el modo Caracterizar. */
-static void SendDatosCaracterizar(void);
+static int32_t EnviarPrealimentacion(uint8_t connectionID, uint8_t motorID)
+{
+	uint8_t buffer[20 + SPEED_CONTROL_FF_POINTS * 6] = "$PREALIMENTACION=";
+	unsigned char * ptr;
+	uint16_t table[SPEED_CONTROL_FF_POINTS];
+	uint8_t points;
+	uint8_t i;
+	AT_CIPSEND_DATA cipsend_data;
 
-/** \brief Función de callback para DataReceived de ESP8266. */
-static void ReceiveData(ReceivedDataInfo info);
+	points = speedControl_getFeedForward(motorID, table);
 
-/** \brief Función de callback para ResetDetected de ESP8266. */
-static void WiFiReset(void);
+	ptr = uintToString(motorID, 1, &(buffer[17]));
+	for (i = 0; i < points; i++)
+	{
+		*ptr++ = ',';
+		ptr = uintToString(table[i], 1, ptr);
+	}
+	*ptr++ = '$';
+	*ptr = '\0';
 
-/** \brief Función de callback para ConnectionChanged de ESP8266. */
-static void ConnectionChanged(ConnectionInfo info);
+	cipsend_data.connectionID = connectionID;
+	cipsend_data.content = (char *)buffer;
+	cipsend_data.length = AT_CIPSEND_ZERO_TERMINATED_CONTENT;
+	cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_COPYTOBUFFER;
 
-/** \brief Cambia de modo a Caracterizar.
- *
- * \param[in] infoPtr Puntero a los parámetros del comando CARACTERIZAR.
- * \param[in] connectionID ID de conexión de quien envió CARACTERIZAR.
- *
- */
-static void ComenzarCaracterizar(PARSER_RESULTS_CARACTERIZAR_T * infoPtr, uint8_t connectionID);
+	return esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
+}
 
-/** \brief Cambia de modo Caracterizar a Control de motores. */
-static void FinalizarCaracterizar(void);
 
-/*==================[internal data definition]===============================*/
+static int32_t EnviarGuion(uint8_t connectionID)
+{
+	uint8_t buffer[] = "$CORRER=E,PCPCP,LONGI,MUESTRAS__$";
+	unsigned char * ptr;
+	ScriptStatus status;
+	AT_CIPSEND_DATA cipsend_data;
 
-/** \brief File descriptor for digital input ports
- *
- * Device path /dev/dio/in/0
- */
-static int32_t fd_in;
+	script_getStatus(&status);
 
-/** \brief File descriptor for digital output ports
- *
- * Device path /dev/dio/out/0
- */
-static int32_t fd_out;
+	ptr = uintToString(status.state, 1, &(buffer[8]));
+	*ptr++ = ',';
+	ptr = uintToString(status.pc, 1, ptr);
+	*ptr++ = ',';
+	ptr = uintToString(status.length, 1, ptr);
+	*ptr++ = ',';
+	ptr = uintToString(status.samples, 1, ptr);
+	*ptr++ = '$';
+	*ptr = '\0';
 
-/** \brief Buffer de recepción de datos a través del módulo WiFi. */
-static uint8_t receiveBuffer[RECEIVE_BUFFER_LENGTH];
+	cipsend_data.connectionID = connectionID;
+	cipsend_data.content = (char *)buffer;
+	cipsend_data.length = AT_CIPSEND_ZERO_TERMINATED_CONTENT;
+	cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_COPYTOBUFFER;
 
-/* Parsers para cada uno de los comandos a capturar */
-static Parser parserDutyCycle = INITIALIZER_DUTYCYCLE;
-static Parser parserCaracterizar = INITIALIZER_CARACTERIZAR;
-static Parser parserCancelarCaracterizar = INITIALIZER_LITERAL_PARSER;
+	return esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
+}
 
-static MotorControlData  lastDutyCycle[MOTOR_COUNT];
 
-/** \brief Indica si se está caracterizando actualmente. */
-static uint8_t caracterizando = 0;
+static int32_t EnviarPwm(uint8_t connectionID)
+{
+	uint8_t buffer[] = "$PWM=ESCRITURAS_,AHORRADAS_$";
+	unsigned char * ptr;
+	PwmWriteStats stats;
+	AT_CIPSEND_DATA cipsend_data;
 
-/** \brief Datos usados para controlar al motor mientras se está caracterizando. */
-static MotorControlData controlCaracterizar;
+	ciaaPWM_getWriteStats(&stats);
 
-/** \brief ID de conexión de quien solicitó la caracterización. */
-static uint8_t caracterizar_connectionID;
+	ptr = uintToString(stats.writes, 1, &(buffer[5]));
+	*ptr++ = ',';
+	ptr = uintToString(stats.savedWrites, 1, ptr);
+	*ptr++ = '$';
+	*ptr = '\0';
 
-/** \brief ID de conexión del usuario que cambió el modo a Control de motores. */
-static uint8_t dutycycle_connectionID = MAX_MULTIPLE_CONNECTIONS;
+	cipsend_data.connectionID = connectionID;
+	cipsend_data.content = (char *)buffer;
+	cipsend_data.length = AT_CIPSEND_ZERO_TERMINATED_CONTENT;
+	cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_COPYTOBUFFER;
 
-/*==================[external data definition]===============================*/
+	return esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
+}
 
-/*==================[internal functions definition]==========================*/
 
-static void apagarMotores(void)
+static int32_t EnviarDeadman(uint8_t connectionID)
 {
-	uint8_t i;
+	uint8_t buffer[] = "$DEADMAN=TIEMPO,DETENCIONES_$";
+	unsigned char * ptr;
+	AT_CIPSEND_DATA cipsend_data;
 
-	for (i = 0; i < MOTOR_COUNT; i++){
-		lastDutyCycle[i].motorID = i;
-		lastDutyCycle[i].dutyCycle = 0;
-		ciaaPWM_updateMotor(lastDutyCycle[i]);
-	}
+	ptr = uintToString(deadman_getTimeout(), 1, &(buffer[9]));
+	*ptr++ = ',';
+	ptr = uintToString(deadman_getTrips(), 1, ptr);
+	*ptr++ = '$';
+	*ptr = '\0';
+
+	cipsend_data.connectionID = connectionID;
+	cipsend_data.content = (char *)buffer;
+	cipsend_data.length = AT_CIPSEND_ZERO_TERMINATED_CONTENT;
+	cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_COPYTOBUFFER;
+
+	return esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
 }
 
-static void SendStatus(void)
+
+static int32_t EnviarSuscripcion(uint8_t connectionID)
 {
-	uint8_t encoder_data[] = "$SPEEDXTVALOR$";
-	uint8_t i;
+	uint8_t buffer[] = "$SUSCRIBIR=DESCARTES_$";
 	unsigned char * ptr;
 	AT_CIPSEND_DATA cipsend_data;
 
-    /* Se comprueba que un usuario haya enviado un comando DUTYCYCLE, y que su conexión siga abierta */
-	if (dutycycle_connectionID < MAX_MULTIPLE_CONNECTIONS && esp8266_getConnectionStatus(dutycycle_connectionID) == CONNECTION_STATUS_OPEN)
-	{
-		cipsend_data.connectionID = dutycycle_connectionID;
-		cipsend_data.content = (char *)encoder_data;
-		cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_COPYTOBUFFER;
+	ptr = uintToString(telemetry_getDroppedFrames(connectionID), 1, &(buffer[11]));
+	*ptr++ = '$';
+	*ptr = '\0';
 
-		for (i = 0; i < ENCODER_COUNT; i++)
-		{
-			ptr = uintToString(i, 1, &(encoder_data[6]));
-			*ptr = '0' + SPEED_TYPE_INTERRUPTS;
-			ptr = uintToString(encoder_getLastCount(i), 4, &(encoder_data[8]));
-			*ptr++ = '$';
-			*ptr = '\0';
+	cipsend_data.connectionID = connectionID;
+	cipsend_data.content = (char *)buffer;
+	cipsend_data.length = AT_CIPSEND_ZERO_TERMINATED_CONTENT;
+	cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_COPYTOBUFFER;
 
-			cipsend_data.length = AT_CIPSEND_ZERO_TERMINATED_CONTENT; /* Dejo que el comando calcule internamente la longitud */
-			esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
-		}
-	}
+	return esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
+}
+
+
+static int32_t EnviarFrecuencia(uint8_t connectionID)
+{
+	uint8_t buffer[] = "$FRECUENCIA=FRECUENCIA,PASOS_____$";
+	unsigned char * ptr;
+	AT_CIPSEND_DATA cipsend_data;
+
+	ptr = uintToString(ciaaPWM_getFrequency(), 1, &(buffer[12]));
+	*ptr++ = ',';
+	ptr = uintToString(ciaaPWM_getResolution(), 1, ptr);
+	*ptr++ = '$';
+	*ptr = '\0';
+
+	cipsend_data.connectionID = connectionID;
+	cipsend_data.content = (char *)buffer;
+	cipsend_data.length = AT_CIPSEND_ZERO_TERMINATED_CONTENT;
+	cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_COPYTOBUFFER;
 
+	return esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
 }
 
 
-static void ComenzarCaracterizar(PARSER_RESULTS_CARACTERIZAR_T * infoPtr, uint8_t connectionID)
+static int32_t EnviarTiempoMuerto(uint8_t connectionID, uint8_t canal)
 {
+	uint8_t buffer[] = "$TIEMPO_MUERTO=CANAL,NANOSEG$";
+	unsigned char * ptr;
 	AT_CIPSEND_DATA cipsend_data;
 
-	if (infoPtr->tiempo <= 10000)
-	{
-	    /* Deshabilito el callback de Encoder porque voy a reconfigurarlo */
-		encoder_setTimeElapsedCallback(0);
+	ptr = uintToString(canal, 1, &(buffer[15]));
+	*ptr++ = ',';
+	ptr = uintToString(ciaaPWM_getDeadTime(canal), 1, ptr);
+	*ptr++ = '$';
+	*ptr = '\0';
 
-        caracterizando = 1;
+	cipsend_data.connectionID = connectionID;
+	cipsend_data.content = (char *)buffer;
+	cipsend_data.length = AT_CIPSEND_ZERO_TERMINATED_CONTENT;
+	cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_COPYTOBUFFER;
 
-		caracterizar_connectionID = connectionID;
+	return esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
+}
 
-        /* Configuro el primer estado para el motor a caracterizar */
-		controlCaracterizar.direction = DIR_FORWARD;
-		controlCaracterizar.dutyCycle = 0;
-		controlCaracterizar.motorID = infoPtr->idMotor;
 
-		ciaaPWM_updateMotor(controlCaracterizar);
+static int32_t EnviarAtasco(uint8_t connectionID, uint8_t motorID)
+{
+	uint8_t buffer[] = "$ATASCO=MOTOR,DUTY,VENTANA,ATASCOS___$";
+	unsigned char * ptr;
+	uint8_t minDuty;
+	uint16_t ventanaMS;
+	int32_t atascos;
+	AT_CIPSEND_DATA cipsend_data;
 
-		encoder_beginCount(infoPtr->tiempo);
-		encoder_setTimeElapsedCallback(SendDatosCaracterizar);
+	atascos = stall_getConfig(motorID, &minDuty, &ventanaMS);
 
-		dutycycle_connectionID = MAX_MULTIPLE_CONNECTIONS;
+	ptr = uintToString(motorID, 1, &(buffer[8]));
+	*ptr++ = ',';
+	ptr = uintToString(minDuty, 1, ptr);
+	*ptr++ = ',';
+	ptr = uintToString(ventanaMS, 1, ptr);
+	*ptr++ = ',';
+	ptr = uintToString(atascos, 1, ptr);
+	*ptr++ = '$';
+	*ptr = '\0';
+
+	cipsend_data.connectionID = connectionID;
+	cipsend_data.content = (char *)buffer;
+	cipsend_data.length = AT_CIPSEND_ZERO_TERMINATED_CONTENT;
+	cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_COPYTOBUFFER;
+
+	return esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
+}
+
+
+static void NotificarAtasco(uint8_t motorID)
+{
+	if (dutycycle_connectionID >= MAX_MULTIPLE_CONNECTIONS)
+	{
+		return;
+	}
+
+	if (protocolo[dutycycle_connectionID] == PROTOCOLO_BINARIO)
+	{
+		EnviarTrama(dutycycle_connectionID, BINPROTO_MSG_ATASCO, &motorID, 1);
 	}
 	else
 	{
-		cipsend_data.connectionID = connectionID;
-		cipsend_data.content = "$ERROR=TIEMPO fuera de rango.$";
-		cipsend_data.length = 30;
-		cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_DONT_COPY;
-		esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
+		EnviarValor("$ATASCADO=", motorID, dutycycle_connectionID);
 	}
 }
 
 
-static void FinalizarCaracterizar(void)
+static int32_t EnviarPing(uint8_t connectionID)
 {
-	encoder_setTimeElapsedCallback(0);
-	caracterizando = 0;
-	encoder_beginCount(1000);
-	encoder_setTimeElapsedCallback(SendStatus);
+	static const char respuesta[] = "$PING$";
+	AT_CIPSEND_DATA cipsend_data;
 
-	apagarMotores();
+	cipsend_data.connectionID = connectionID;
+	cipsend_data.content = respuesta;
+	cipsend_data.length = sizeof(respuesta) - 1;
+	cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_DONT_COPY;
+
+	return esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
 }
 
 
-static void SendDatosCaracterizar(void)
+static int32_t EnviarPerf(uint8_t connectionID)
 {
-	uint8_t buffer[] = "$MOTOR=IDMOTOR,DUTYCYCLE,CANTINTERRUPCIONES$";
+	uint8_t buffer[16 + PERF_SECTION_COUNT * 33] = "$PERF=";
 	unsigned char * ptr;
+	PerfStats stats;
 	AT_CIPSEND_DATA cipsend_data;
+	uint8_t i;
+
+	ptr = uintToString(MOTOR_COUNT, 1, &(buffer[6]));
+	*ptr++ = ',';
+	ptr = uintToString(timestamp_cyclesPerMicrosecond(), 1, ptr);
+
+	for (i = 0; i < PERF_SECTION_COUNT; i++)
+	{
+		perf_getStats(i, &stats);
+		*ptr++ = ',';
+		ptr = uintToString(stats.count, 1, ptr);
+		*ptr++ = ',';
+		ptr = uintToString(stats.averageCycles, 1, ptr);
+		*ptr++ = ',';
+		ptr = uintToString(stats.maxCycles, 1, ptr);
+	}
+	*ptr++ = '$';
 
-	cipsend_data.connectionID = caracterizar_connectionID;
+	cipsend_data.connectionID = connectionID;
 	cipsend_data.content = (char *)buffer;
+	cipsend_data.length = (uint16_t)(ptr - buffer);
 	cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_COPYTOBUFFER;
 
-	ptr = uintToString(controlCaracterizar.motorID, 1, &(buffer[7]));
-	*ptr++ = ',';
-	ptr = uintToString(controlCaracterizar.dutyCycle, 1, ptr);
-	*ptr++ = ',';
-	ptr = uintToString(encoder_getLastCount(controlCaracterizar.motorID), 1, ptr);
-	*ptr++ = '$';
-	*ptr = '\0';
+	return esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
+}
 
-	cipsend_data.length = AT_CIPSEND_ZERO_TERMINATED_CONTENT; /* Dejo que el comando calcule internamente la longitud */
-	esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
 
-	if (controlCaracterizar.dutyCycle < 100)
+static int32_t EnviarValor(const char * prefijo, uint32_t valor, uint8_t connectionID)
+{
+	uint8_t buffer[32];
+	unsigned char * ptr = buffer;
+	AT_CIPSEND_DATA cipsend_data;
+
+	while (*prefijo != '\0' && ptr < &buffer[20])
 	{
-		controlCaracterizar.dutyCycle++;
-		ciaaPWM_updateMotor(controlCaracterizar);
-		encoder_resetCount();
+		*ptr++ = *prefijo++;
 	}
-	else
-	{
-		cipsend_data.content = "$FIN_CARACTERIZAR$";
-		cipsend_data.length = 18;
-		cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_DONT_COPY;
+	ptr = uintToString(valor, 1, ptr);
+	*ptr++ = '$';
 
-		esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
+	cipsend_data.connectionID = connectionID;
+	cipsend_data.content = (char *)buffer;
+	cipsend_data.length = (uint16_t)(ptr - buffer);
+	cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_COPYTOBUFFER;
 
-		FinalizarCaracterizar();
-	}
+	return esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
+}
 
+
+static int32_t EnviarTrama(uint8_t connectionID, uint8_t tipo, const uint8_t * payload, uint8_t length)
+{
+	uint8_t trama[BINPROTO_MAX_FRAME_LENGTH];
+	AT_CIPSEND_DATA cipsend_data;
+
+	cipsend_data.connectionID = connectionID;
+	cipsend_data.content = (char *)trama;
+	cipsend_data.length = binproto_encode(tipo, payload, length, trama);
+	cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_COPYTOBUFFER;
+
+	return esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
 }
 
+
 static const char staticResponseHeaders[] =
 		"HTTP/1.1 200 OK\r\n"
 		"Cache-Control: no-cache\r\n"
@@ -226,11 +1608,37 @@ static const char staticResponseHeaders[] =
 		"</body>\r\n"
 		"</html>";
 
+static const char sseResponseHeaders[] =
+		"HTTP/1.1 200 OK\r\n"
+		"Cache-Control: no-cache\r\n"
+		"Content-Type: text/event-stream\r\n"
+		"Connection: keep-alive\r\n"
+		"\r\n";
+
 static void ReceiveData(ReceivedDataInfo info)
 {
 	uint16_t i;
+	uint16_t length;
 	AT_CIPSEND_DATA cipsend_data;
-	PARSER_RESULTS_DUTYCYCLE_T * dutyCycleResults;
+
+	length = (info.payloadLength > info.bufferLength ? info.bufferLength : info.payloadLength);
+
+	if (info.connectionID >= MAX_MULTIPLE_CONNECTIONS)
+	{
+		return;
+	}
+
+	if (protocolo[info.connectionID] == PROTOCOLO_BINARIO)
+	{
+		binproto_decode(&decoders[info.connectionID], receiveBuffer, length, ProcesarTrama, info.connectionID);
+
+		AplicarDutyCycles();
+		if (info.connectionID == dutycycle_connectionID)
+		{
+			deadman_feed();
+		}
+		return;
+	}
 
 	if (ciaaPOSIX_strncmp("GET / HTTP/1.1", receiveBuffer, 14) == 0)
 	{
@@ -242,37 +1650,28 @@ static void ReceiveData(ReceivedDataInfo info)
 
 		esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data);
 	}
+	else if (ciaaPOSIX_strncmp(SSE_REQUEST, receiveBuffer, SSE_REQUEST_LENGTH) == 0)
+	{
+		/* Se abre el stream SSE: se envían los encabezados y a partir de ahora la conexión
+		 * recibe un evento por cada período de conteo de los encoders */
+		cipsend_data.connectionID = info.connectionID;
+		cipsend_data.content = sseResponseHeaders;
+		cipsend_data.length = sizeof(sseResponseHeaders) - 1;
+		cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_DONT_COPY;
 
-	/* Pongo el número de motor en un valor incorrecto. Esto es para evitar
-	 * actualizar las salidas PWM si es que no se recibió un comando de
-	 * usuario para ello.
-	 */
-	for (i = 0; i < MOTOR_COUNT; i++){
-		lastDutyCycle[i].motorID = MOTOR_COUNT + 1;
+		if (esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data) >= 0)
+		{
+			telemetry_subscribe(info.connectionID, TELEMETRY_STREAM_SPEED, 1, TELEMETRY_FORMAT_SSE);
+		}
 	}
 
-	for (i = 0; i < (info.payloadLength > info.bufferLength ? info.bufferLength : info.payloadLength); i++)
+	for (i = 0; i < length && protocolo[info.connectionID] == PROTOCOLO_ASCII; i++)
 	{
 		if (!caracterizando)
 		{
 			if (parser_tryMatch(&parserDutyCycle, receiveBuffer[i]) == STATUS_COMPLETE)
 			{
-
-                /* Si no hay ningún usuario controlando los motores... */
-				if (dutycycle_connectionID >= MAX_MULTIPLE_CONNECTIONS)
-				{
-				    /* ... entonces quien envió este comando los controlará */
-					dutycycle_connectionID = info.connectionID;
-				}
-
-				dutyCycleResults = parser_getResults(&parserDutyCycle);
-
-				/* Verifico que el usuario que envío el comando sea quien controla los motores, y que el
-				   identificador del motor sea válido */
-				if (dutycycle_connectionID == info.connectionID && dutyCycleResults->motorID < MOTOR_COUNT)
-				{
-					lastDutyCycle[dutyCycleResults->motorID] = *dutyCycleResults;
-				}
+				RegistrarDutyCycle(parser_getResults(&parserDutyCycle), info.connectionID);
 			}
 
 			if (parser_tryMatch(&parserCaracterizar, receiveBuffer[i]) == STATUS_COMPLETE)
@@ -280,7 +1679,7 @@ static void ReceiveData(ReceivedDataInfo info)
 				ComenzarCaracterizar(parser_getResults(&parserCaracterizar), info.connectionID);
 			}
 		}
-		else /* Se está caracterizando, sólo acepto comando CANCELAR_CARACTERIZAR. */
+		else /* Se está caracterizando, sólo acepto comando CANCELAR_CARACTERIZAR y los comandos genéricos. */
 		{
 			if (parser_tryMatch(&parserCancelarCaracterizar, receiveBuffer[i]) == STATUS_COMPLETE)
 			{
@@ -288,11 +1687,25 @@ static void ReceiveData(ReceivedDataInfo info)
 			}
 		}
 
+		if (parser_tryMatch(&parserComando, receiveBuffer[i]) == STATUS_COMPLETE)
+		{
+			ProcesarComando(parser_getResults(&parserComando), info.connectionID);
+		}
+	}
 
+	/* Si la conexión pasó al protocolo binario, el resto del mensaje ya son tramas */
+	if (i < length)
+	{
+		binproto_decode(&decoders[info.connectionID], &receiveBuffer[i], length - i, ProcesarTrama, info.connectionID);
 	}
 
-	for (i = 0; i < MOTOR_COUNT; i++){
-		ciaaPWM_updateMotor(lastDutyCycle[i]);
+	/* Los motores con un ciclo de trabajo nuevo se actualizan juntos, en una única escritura de las salidas PWM */
+	AplicarDutyCycles();
+
+	/* Cualquier dato de quien controla los motores, incluso un $PING$, los mantiene en marcha */
+	if (info.connectionID == dutycycle_connectionID)
+	{
+		deadman_feed();
 	}
 
 }
@@ -303,6 +1716,8 @@ static void WiFiReset(void)
 	AT_CWSAP_DATA cwsap_data = {"wifi", "12345678", 11, AT_SAP_ENCRYPTION_WPA2_PSK};
 	AT_CIPSERVER_DATA cipserver_data = {AT_CIPSERVER_CREATE, 8080};
 
+	/* Antes de configurar el módulo, se detecta qué comandos soporta su firmware */
+	esp8266_queueProbe();
 	esp8266_queueCommand(AT_CWMODE, AT_TYPE_SET, (void*)AT_CWMODE_SOFTAP);
 	esp8266_queueCommand(AT_CWSAP_CUR, AT_TYPE_SET, &cwsap_data);
 	esp8266_queueCommand(AT_CIPMUX, AT_TYPE_SET, (void*)AT_CIPMUX_MULTIPLE_CONNECTION);
@@ -319,6 +1734,21 @@ static void WiFiReset(void)
 
 static void ConnectionChanged(ConnectionInfo info)
 {
+	/* Si se cerró una conexión suscripta (por ejemplo, un stream SSE), se deja de enviarle datos */
+	if (info.newStatus == CONNECTION_STATUS_CLOSE)
+	{
+		telemetry_unsubscribe(info.connectionID);
+		trace_connectionClosed(info.connectionID);
+	}
+
+	/* Toda conexión nueva comienza usando el protocolo ASCII */
+	if (info.connectionID < MAX_MULTIPLE_CONNECTIONS && info.newStatus == CONNECTION_STATUS_CLOSE)
+	{
+		protocolo[info.connectionID] = PROTOCOLO_ASCII;
+		binproto_initDecoder(&decoders[info.connectionID]);
+		telemetry_setFormat(info.connectionID, TELEMETRY_FORMAT_ASCII);
+	}
+
     /* Si la conexión de quien controlaba los motores se cerró, debo apagar los motores y permitir
        que otro usuario los controle */
 	if (info.connectionID == dutycycle_connectionID && info.newStatus == CONNECTION_STATUS_CLOSE)
@@ -388,6 +1818,7 @@ void ErrorHook(void)
 TASK(InitTask)
 {
 	uint16_t gpio_buffer;
+	uint8_t i;
 
 	// Frecuencia cambiada en externals/drivers/cortexM4/lpc43xx/inc/clock_18xx_43xx.h
 	// y en 				  externals/drivers/cortexM0/lpc43xx/inc/clock_18xx_43xx.h
@@ -420,6 +1851,14 @@ TASK(InitTask)
 	parser_init(&parserCaracterizar);
 	parser_init(&parserCancelarCaracterizar);
 	literalParser_setStringToMatch(&parserCancelarCaracterizar, "$CANCELAR_CARACTERIZAR$");
+	parser_init(&parserComando);
+	comandoParser_setCommands(&parserComando, comandos, COMANDO_COUNT);
+
+	for (i = 0; i < MAX_MULTIPLE_CONNECTIONS; i++)
+	{
+		protocolo[i] = PROTOCOLO_ASCII;
+		binproto_initDecoder(&decoders[i]);
+	}
 
 	/* Configuracion de los GPIO de salida. */
 	/* Habilitacion de los enable, /reset y chip_enable del puente H. */
@@ -437,8 +1876,22 @@ TASK(InitTask)
 	esp8266_queueCommand(AT_RST, AT_TYPE_EXECUTE, 0);
 
     /* Inicio el módulo ENCODER */
-	encoder_init();
+	if (encoder_init() < 0)
+	{
+		ciaaPOSIX_printf("La descripcion de los encoders de la placa es invalida\n");
+		ShutdownOS(0);
+	}
+	telemetry_init();
 	encoder_setTimeElapsedCallback(SendStatus);
+
+	/* La odometría y el control de velocidad procesan cada muestra de los encoders */
+	odometry_init();
+	speedControl_init();
+	drive_init();
+	deadman_init();
+	stall_init();
+	stall_setCallback(NotificarAtasco);
+	encoder_setSampleCallback(ProcesarMuestra);
 	encoder_beginCount(1000);
 
     /* Inicio el módulo Debug Logger */
@@ -470,6 +1923,9 @@ TASK(BackgroundTask)
 		}
 #endif
 
+		/* La traza de flancos se envía desde aquí, con la menor prioridad */
+		trace_doWork();
+
 		esp8266_doWork();
 
 		__WFI(); /* Wait for Interrupt */
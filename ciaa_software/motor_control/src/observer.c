@@ -0,0 +1,53 @@
+/*==================[inclusions]=============================================*/
+
+#include "observer.h"
+
+/*==================[macros and definitions]=================================*/
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+/*==================[external functions definition]==========================*/
+
+extern int32_t observer_setGains(ObserverGains * gains, uint16_t alphaMilli)
+{
+	uint32_t alpha;
+
+	if (alphaMilli == 0 || alphaMilli >= 1000)
+	{
+		return -1;
+	}
+
+	alpha = ((uint32_t)alphaMilli * OBSERVER_ONE) / 1000;
+
+	gains->alpha = alpha;
+	gains->beta = (int32_t)(((uint64_t)alpha * alpha) / (2 * OBSERVER_ONE - alpha));
+
+	return 1;
+}
+
+
+extern void observer_reset(ObserverState * state, uint32_t position)
+{
+	state->position = position;
+	state->velocity = 0;
+}
+
+
+extern void observer_update(ObserverState * state, const ObserverGains * gains, uint32_t measurement)
+{
+	uint32_t predicted = state->position + (uint32_t)state->velocity;
+	int32_t residual = (int32_t)(measurement - predicted);
+
+	state->position = predicted + (uint32_t)(int32_t)(((int64_t)gains->alpha * residual) >> OBSERVER_Q_BITS);
+	state->velocity += (int32_t)(((int64_t)gains->beta * residual) >> OBSERVER_Q_BITS);
+}
+
+/*==================[end of file]============================================*/
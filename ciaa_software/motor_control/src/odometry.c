@@ -0,0 +1,204 @@
+/*==================[inclusions]=============================================*/
+
+#include "odometry.h"
+#include "encoder.h"
+#include "board.h"
+
+/*==================[macros and definitions]=================================*/
+
+/** \brief Pi * 65536, para calcular la circunferencia de las ruedas en Q16. */
+#define PI_Q16					(205887)
+
+/** \brief Ángulo binario de una vuelta completa dividido 2 * pi: radianes a ángulo binario. */
+#define BINARY_ANGLE_PER_RAD	(683565276LL)
+
+/** \brief Ángulo binario de un cuarto de vuelta. */
+#define QUARTER_TURN			(0x40000000UL)
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+static int32_t odometry_sin(uint32_t angle);
+
+/*==================[internal data definition]===============================*/
+
+/** \brief Seno de un cuarto de vuelta en 64 pasos, en Q15. */
+static const int16_t sinTable[65] = {
+		    0,   804,  1608,  2410,  3212,  4011,  4808,  5602,
+		 6393,  7179,  7962,  8739,  9512, 10278, 11039, 11793,
+		12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+		18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+		23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+		27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+		30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+		32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+		32767
+};
+
+/** \brief Avance de cada rueda por cuenta del encoder, en Q16 milímetros. */
+static int32_t leftMMPerCount;
+static int32_t rightMMPerCount;
+
+/** \brief Trocha en milímetros. */
+static uint16_t trackMM;
+
+/** \brief Geometría pedida por otra tarea, se aplica en la próxima muestra. */
+static uint16_t requestedDiameterMM;
+static uint16_t requestedTrackWidthMM;
+static volatile uint8_t geometryRequested;
+
+/** \brief Posición en Q16 milímetros y orientación como ángulo binario. Sólo las escribe EncoderTask. */
+static int64_t x;
+static int64_t y;
+static uint32_t heading;
+
+/** \brief Posición de cada encoder en la muestra anterior. */
+static int32_t lastLeft;
+static int32_t lastRight;
+
+/** \brief Indica que las posiciones anteriores todavía no son válidas. */
+static uint8_t firstSample;
+
+/** \brief Reinicio pedido por otra tarea, se aplica en la próxima muestra. */
+static volatile uint8_t resetRequested;
+
+/** \brief Cantidad de actualizaciones, para que los lectores detecten si fueron interrumpidos. */
+static volatile uint32_t updateCount;
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+/** \brief Seno de un ángulo binario, en Q15. */
+static int32_t odometry_sin(uint32_t angle)
+{
+	uint32_t offset = angle & (QUARTER_TURN - 1);
+	uint32_t index;
+	int32_t value;
+
+	/* El segundo y el cuarto cuadrante recorren la tabla al revés */
+	if (angle & QUARTER_TURN)
+	{
+		offset = QUARTER_TURN - offset;
+	}
+
+	index = offset >> 24;
+	if (index >= 64)
+	{
+		value = sinTable[64];
+	}
+	else
+	{
+		value = sinTable[index] + (((sinTable[index + 1] - sinTable[index]) * (int32_t)((offset >> 8) & 0xFFFF)) >> 16);
+	}
+
+	/* La segunda media vuelta es negativa */
+	return (angle & (2 * QUARTER_TURN) ? -value : value);
+}
+
+/*==================[external functions definition]==========================*/
+
+extern void odometry_init(void)
+{
+	leftMMPerCount = (BOARD_WHEEL_DIAMETER_MM * PI_Q16) / encoder_getCountsPerRevolution(BOARD_LEFT_ENCODER);
+	rightMMPerCount = (BOARD_WHEEL_DIAMETER_MM * PI_Q16) / encoder_getCountsPerRevolution(BOARD_RIGHT_ENCODER);
+	trackMM = BOARD_TRACK_WIDTH_MM;
+	geometryRequested = 0;
+
+	x = 0;
+	y = 0;
+	heading = 0;
+	firstSample = 1;
+	resetRequested = 0;
+}
+
+
+extern void odometry_update(void)
+{
+	int32_t left = encoder_getSamplePosition(BOARD_LEFT_ENCODER);
+	int32_t right = encoder_getSamplePosition(BOARD_RIGHT_ENCODER);
+	int64_t leftMM;
+	int64_t rightMM;
+	int64_t distance;
+	int32_t turn;
+	uint32_t midHeading;
+
+	if (resetRequested)
+	{
+		x = 0;
+		y = 0;
+		heading = 0;
+		resetRequested = 0;
+	}
+
+	if (geometryRequested)
+	{
+		leftMMPerCount = (int32_t)(((uint32_t)requestedDiameterMM * PI_Q16) / encoder_getCountsPerRevolution(BOARD_LEFT_ENCODER));
+		rightMMPerCount = (int32_t)(((uint32_t)requestedDiameterMM * PI_Q16) / encoder_getCountsPerRevolution(BOARD_RIGHT_ENCODER));
+		trackMM = requestedTrackWidthMM;
+		geometryRequested = 0;
+	}
+
+	if (firstSample)
+	{
+		firstSample = 0;
+	}
+	else
+	{
+		leftMM = (int64_t)(left - lastLeft) * leftMMPerCount;
+		rightMM = (int64_t)(right - lastRight) * rightMMPerCount;
+
+		distance = (leftMM + rightMM) / 2;
+		turn = (int32_t)(((rightMM - leftMM) * BINARY_ANGLE_PER_RAD / trackMM) >> 16);
+
+		/* El avance se proyecta con la orientación a mitad del giro de la muestra */
+		midHeading = heading + (turn / 2);
+		x += (distance * odometry_sin(midHeading + QUARTER_TURN)) >> 15;
+		y += (distance * odometry_sin(midHeading)) >> 15;
+		heading += (uint32_t)turn;
+	}
+
+	lastLeft = left;
+	lastRight = right;
+	updateCount++;
+}
+
+
+extern void odometry_reset(void)
+{
+	resetRequested = 1;
+}
+
+
+extern int32_t odometry_setGeometry(uint16_t wheelDiameterMM, uint16_t trackWidthMM)
+{
+	/* El avance por vuelta, diámetro * pi en Q16, debe entrar en 32 bits */
+	if (wheelDiameterMM == 0 || trackWidthMM == 0 || wheelDiameterMM > 20000)
+	{
+		return -1;
+	}
+
+	requestedDiameterMM = wheelDiameterMM;
+	requestedTrackWidthMM = trackWidthMM;
+	geometryRequested = 1;
+
+	return 1;
+}
+
+
+extern void odometry_getPose(OdometryPose * pose)
+{
+	uint32_t count;
+
+	/* Si EncoderTask actualizó la pose durante la lectura, se repite */
+	do
+	{
+		count = updateCount;
+		pose->xMM = (int32_t)(x >> 16);
+		pose->yMM = (int32_t)(y >> 16);
+		pose->headingMrad = (uint16_t)(((uint64_t)heading * 6283) >> 32);
+	} while (count != updateCount);
+}
+
+/*==================[end of file]============================================*/
@@ -0,0 +1,63 @@
+/*==================[inclusions]=============================================*/
+
+#include "perf.h"
+
+/*==================[macros and definitions]=================================*/
+
+/*==================[internal data declaration]==============================*/
+
+typedef struct {
+	uint32_t	count;
+	uint64_t	totalCycles;
+	uint32_t	maxCycles;
+} perfSectionData;
+
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+
+static perfSectionData sections[PERF_SECTION_COUNT];
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+/*==================[external functions definition]==========================*/
+
+extern void perf_end(PerfSection section, uint32_t start)
+{
+	uint32_t cycles = timestamp_now() - start;
+	perfSectionData * data = &sections[section];
+
+	data->count++;
+	data->totalCycles += cycles;
+	if (cycles > data->maxCycles)
+	{
+		data->maxCycles = cycles;
+	}
+}
+
+
+extern void perf_getStats(PerfSection section, PerfStats * stats)
+{
+	perfSectionData data = sections[section];
+
+	stats->count = data.count;
+	stats->averageCycles = (data.count > 0 ? (uint32_t)(data.totalCycles / data.count) : 0);
+	stats->maxCycles = data.maxCycles;
+}
+
+
+extern void perf_reset(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < PERF_SECTION_COUNT; i++)
+	{
+		sections[i].count = 0;
+		sections[i].totalCycles = 0;
+		sections[i].maxCycles = 0;
+	}
+}
+
+/*==================[end of file]============================================*/
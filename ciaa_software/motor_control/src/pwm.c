@@ -1,94 +1,436 @@
 /*==================[inclusions]=============================================*/
 
 #include "pwm.h"
+#include "board.h"
+#include "perf.h"
+#include "os.h"               /* <= operating system header */
+#if BOARD_PWM_DIRECT
+#include "chip.h"
+#endif
 
 /*==================[macros and definitions]=================================*/
 
+/** \brief Cantidad de señales PWM, dos por motor. */
+#define PWM_CHANNEL_COUNT	(BOARD_PWM_CHANNEL_COUNT)
+
+/** \brief Cantidad de motores que maneja el módulo. */
+#define PWM_MOTOR_COUNT		(BOARD_MOTOR_COUNT)
+
+/** \brief Registro de match del SCT de cada señal; el 0 fija el período. */
+#define PWM_SCT_MATCH(channel)	((channel) + 1)
+
+/** \brief Registro de match del SCT que activa cada señal al terminar su tiempo muerto. */
+#define PWM_SCT_DEADTIME_MATCH(channel)	((channel) + 1 + PWM_CHANNEL_COUNT)
+
+/** \brief Quedan registros de match para el tiempo muerto de todas las señales. */
+#define PWM_DEADTIME_SUPPORTED	(BOARD_PWM_DIRECT && PWM_CHANNEL_COUNT * 2 <= 15)
+
 /*==================[internal data declaration]==============================*/
 
 /*==================[internal functions declaration]=========================*/
 
+/** \brief Escribe el ciclo de trabajo de una señal. */
+static void ciaaPWM_writeChannel(uint8_t channel, uint16_t duty);
+
+/** \brief Comienza a acumular escrituras, que el SCT no toma hasta \p ciaaPWM_commit(). */
+static void ciaaPWM_stage(void);
+
+/** \brief Habilita la recarga, todas las escrituras acumuladas se aplican juntas al comenzar el próximo período. */
+static void ciaaPWM_commit(void);
+
+/** \brief Convierte un tiempo muerto en ns a ciclos de reloj del SCT. */
+static uint32_t ciaaPWM_deadTimeTicks(uint16_t deadTimeNS);
+
 /*==================[internal data definition]===============================*/
 
-/** \brief File descriptor for PWM 0
- *
- * Device path /dev/dio/pwm/0
- */
-static int32_t fd_pwm0;
+#if BOARD_PWM_DIRECT
+/** \brief Ciclos de reloj del período PWM, el valor del match 0. */
+static uint32_t periodTicks;
 
-/** \brief File descriptor for PWM 1
- *
- * Device path /dev/dio/pwm/1
- */
-static int32_t fd_pwm1;
+/** \brief Ciclos de reloj del tiempo muerto de cada señal, al comienzo de cada período. */
+static uint32_t deadTicks[PWM_CHANNEL_COUNT];
+
+/** \brief Frecuencia configurada, en Hz. */
+static uint32_t frequency = BOARD_PWM_FREQUENCY_HZ;
 
-/** \brief File descriptor for PWM 2
+/** \brief Tiempo muerto configurado de cada señal, en ns. */
+static uint16_t deadTimeNS[PWM_CHANNEL_COUNT];
+
+/** \brief Hay una configuración nueva, que EncoderTask aplica en \p ciaaPWM_applyConfig(). */
+static volatile uint8_t configPending = 0;
+#else
+/** \brief File descriptor de cada señal PWM, indexados por número de canal.
  *
- * Device path /dev/dio/pwm/2
+ * Device path y salida del SCT de cada uno en \p boardPwmChannels.
  */
-static int32_t fd_pwm2;
+static int32_t fd_pwm[PWM_CHANNEL_COUNT];
+#endif
 
-/** \brief File descriptor for PWM 3
+/** \brief Canal PWM de cada motor para cada sentido, indexado por \p MotorDirection.
  *
- * Device path /dev/dio/pwm/3
+ * Se arma a partir de \p boardMotors para resolver el canal con un único acceso.
  */
-static int32_t fd_pwm3;
+static uint8_t motorChannels[PWM_MOTOR_COUNT][2];
+
+/** \brief Último estado aplicado a cada motor. */
+static MotorPwmData motorState[PWM_MOTOR_COUNT];
+
+/** \brief Escrituras de las señales, y las que no se hicieron por no haber cambios. */
+static PwmWriteStats writeStats;
 
 /*==================[external data definition]===============================*/
 
 /*==================[internal functions definition]==========================*/
 
+static void ciaaPWM_writeChannel(uint8_t channel, uint16_t duty)
+{
+#if BOARD_PWM_DIRECT
+	/* La señal se activa al terminar su tiempo muerto y el ciclo de trabajo se reparte en el resto del
+	   período. Multiplicación de 32x32 bits y desplazamiento en lugar de división; 100 % es el período completo */
+	uint32_t span = periodTicks - deadTicks[channel];
+	uint32_t ticks = deadTicks[channel] +
+			(duty == PWM_DUTY_MAX ? span : (uint32_t)(((uint64_t)span * duty) >> 16));
+
+#if PWM_DEADTIME_SUPPORTED
+	/* Sin tiempo muerto, 100 % no debe desactivar la señal en el límite del período: el match
+	   queda después del límite, donde el contador nunca llega */
+	if (duty == PWM_DUTY_MAX && deadTicks[channel] == 0)
+	{
+		ticks = periodTicks + 1;
+	}
+#endif
+
+	Chip_SCTPWM_SetDutyCycle(LPC_SCT, PWM_SCT_MATCH(channel), ticks);
+#else
+	uint8_t percent = ciaaPWM_dutyToPercent(duty);
+
+	ciaaPOSIX_write(fd_pwm[channel], &percent, 1);
+#endif
+}
+
+static void ciaaPWM_stage(void)
+{
+#if BOARD_PWM_DIRECT
+	LPC_SCT->CONFIG |= SCT_CONFIG_NORELOADL_U;
+#endif
+}
+
+
+static void ciaaPWM_commit(void)
+{
+#if BOARD_PWM_DIRECT
+	LPC_SCT->CONFIG &= ~SCT_CONFIG_NORELOADL_U;
+#endif
+}
+
+
+#if BOARD_PWM_DIRECT
+static uint32_t ciaaPWM_deadTimeTicks(uint16_t deadTimeNS)
+{
+	return (uint32_t)(((uint64_t)deadTimeNS * Chip_Clock_GetRate(CLK_MX_SCT)) / 1000000000u);
+}
+#endif
+
 /*==================[external functions definition]==========================*/
 
 extern void ciaaPWM_init(void)
 {
-	uint8_t min_duty_cycle = MIN_DUTY_CYCLE;
+	uint8_t i;
+
+#if BOARD_PWM_DIRECT
+	Chip_SCTPWM_Init(LPC_SCT);
+	Chip_SCTPWM_SetRate(LPC_SCT, BOARD_PWM_FREQUENCY_HZ);
+	periodTicks = Chip_SCTPWM_GetTicksPerCycle(LPC_SCT);
+
+	for (i = 0; i < PWM_CHANNEL_COUNT; i++)
+	{
+		Chip_SCU_PinMux(boardPwmChannels[i].portNumber, boardPwmChannels[i].pinNumber, MD_PLN, boardPwmChannels[i].pinFunction);
+		Chip_SCTPWM_SetOutPin(LPC_SCT, PWM_SCT_MATCH(i), boardPwmChannels[i].sctOutput);
+#if PWM_DEADTIME_SUPPORTED
+		/* La señal se activa con el evento de su match de tiempo muerto, en lugar del límite del período */
+		LPC_SCT->EVENT[PWM_SCT_DEADTIME_MATCH(i)].CTRL = PWM_SCT_DEADTIME_MATCH(i) | (1 << 12); /* Sólo match */
+		LPC_SCT->EVENT[PWM_SCT_DEADTIME_MATCH(i)].STATE = 1;
+		LPC_SCT->OUT[boardPwmChannels[i].sctOutput].SET = (1u << PWM_SCT_DEADTIME_MATCH(i));
+
+		/* Con ciclo de trabajo 0 el match que la desactiva coincide con el que la activa: en ese
+		   conflicto la señal debe quedar desactivada (Chip_SCTPWM_SetOutPin() la activa) */
+		LPC_SCT->RES = (LPC_SCT->RES & ~(3u << (boardPwmChannels[i].sctOutput << 1))) |
+				(2u << (boardPwmChannels[i].sctOutput << 1));
+		Chip_SCTPWM_SetDutyCycle(LPC_SCT, PWM_SCT_DEADTIME_MATCH(i), 0);
+#endif
+		ciaaPWM_writeChannel(i, ciaaPWM_percentToDuty(MIN_DUTY_CYCLE));
+	}
 
-	/* Opening of PWM channels and initialization */
-	fd_pwm0 = ciaaPOSIX_open("/dev/dio/pwm/0", SCT_PWM_PIN_1A);
-	fd_pwm1 = ciaaPOSIX_open("/dev/dio/pwm/1", SCT_PWM_PIN_4A);
-	fd_pwm2 = ciaaPOSIX_open("/dev/dio/pwm/2", SCT_PWM_PIN_2A);
-	fd_pwm3 = ciaaPOSIX_open("/dev/dio/pwm/3", SCT_PWM_PIN_3A);
+	Chip_SCTPWM_Start(LPC_SCT);
+#else
+	/* Opening of PWM channels and setting initial dutycycle value */
+	for (i = 0; i < PWM_CHANNEL_COUNT; i++)
+	{
+		fd_pwm[i] = ciaaPOSIX_open(boardPwmChannels[i].devicePath, boardPwmChannels[i].sctOutput);
+		ciaaPWM_writeChannel(i, ciaaPWM_percentToDuty(MIN_DUTY_CYCLE));
+	}
+#endif
 
-    /* Setting initial dutycycle value */
-	ciaaPOSIX_write(fd_pwm0, &min_duty_cycle, 1);
-	ciaaPOSIX_write(fd_pwm1, &min_duty_cycle, 1);
-	ciaaPOSIX_write(fd_pwm2, &min_duty_cycle, 1);
-	ciaaPOSIX_write(fd_pwm3, &min_duty_cycle, 1);
+	for (i = 0; i < PWM_MOTOR_COUNT; i++)
+	{
+		motorChannels[i][DIR_FORWARD] = boardMotors[i].forwardChannel;
+		motorChannels[i][DIR_BACKWARD] = boardMotors[i].backwardChannel;
 
+		motorState[i].motorID = i;
+		motorState[i].duty = ciaaPWM_percentToDuty(MIN_DUTY_CYCLE);
+		motorState[i].direction = DIR_FORWARD;
+	}
 }
 
 
 extern void ciaaPWM_updateMotor(MotorControlData data)
 {
-	uint8_t zero = 0;
+	ciaaPWM_updateMotors(&data, 1);
+}
+
+
+extern void ciaaPWM_updateMotors(const MotorControlData * data, uint8_t count)
+{
+	MotorPwmData pwm[PWM_MOTOR_COUNT];
+	uint8_t n = 0;
+	uint8_t i;
 
-	switch(data.motorID){
-	case 0:
-		if (data.direction == DIR_FORWARD){
-			ciaaPOSIX_write(fd_pwm2, &zero, 1);
-			ciaaPOSIX_write(fd_pwm0, &data.dutyCycle, 1); /* T_COL1 para adelante */
+	for (i = 0; i < count && n < PWM_MOTOR_COUNT; i++)
+	{
+		if (data[i].motorID < PWM_MOTOR_COUNT)
+		{
+			pwm[n].motorID = data[i].motorID;
+			pwm[n].duty = ciaaPWM_percentToDuty(data[i].dutyCycle > 100 ? 100 : data[i].dutyCycle);
+			pwm[n].direction = data[i].direction;
+			n++;
 		}
-		else{
-			ciaaPOSIX_write(fd_pwm0, &zero, 1);
-			ciaaPOSIX_write(fd_pwm2, &data.dutyCycle, 1); /* T_FIL3 para atrás */
+	}
+
+	ciaaPWM_writeMotors(pwm, n);
+}
+
+
+extern void ciaaPWM_writeMotors(const MotorPwmData * data, uint8_t count)
+{
+	uint16_t duty[PWM_CHANNEL_COUNT];
+	uint16_t enabled = 0; /* Máscara de canales que quedan habilitados */
+	uint16_t disabled = 0; /* Máscara de canales que se ponen en cero */
+	uint32_t start = perf_begin();
+	uint8_t channel;
+	uint8_t i;
+
+	/* Las salidas se escriben desde varias tareas: el estado aplicado y el SCT se modifican
+	   juntos, sin que otra escritura pueda interrumpirlos */
+	GetResource(PWMR);
+
+	/* Se calculan todos los valores antes de escribir cualquiera de ellos */
+	for (i = 0; i < count; i++)
+	{
+		if (data[i].motorID >= PWM_MOTOR_COUNT)
+		{
+			continue; /* Invalid motor number */
 		}
-		break;
 
-	case 1:
-		if (data.direction == DIR_FORWARD){
-			ciaaPOSIX_write(fd_pwm1, &zero, 1);
-			ciaaPOSIX_write(fd_pwm3, &data.dutyCycle, 1); /* T_FIL2 para adelante */
+		/* Sin cambios respecto del estado aplicado (con ciclo de trabajo 0 el sentido no importa) */
+		if (data[i].duty == motorState[data[i].motorID].duty &&
+				(data[i].direction == motorState[data[i].motorID].direction || data[i].duty == 0))
+		{
+			writeStats.savedWrites += 2;
+			continue;
 		}
-		else{
-			ciaaPOSIX_write(fd_pwm3, &zero, 1);
-			ciaaPOSIX_write(fd_pwm1, &data.dutyCycle, 1); /* T_COL0 para atrás */
+
+		channel = motorChannels[data[i].motorID][data[i].direction == DIR_FORWARD ? DIR_BACKWARD : DIR_FORWARD];
+		duty[channel] = 0;
+		disabled |= (1u << channel);
+		enabled &= ~(1u << channel);
+
+		channel = motorChannels[data[i].motorID][data[i].direction];
+		duty[channel] = data[i].duty;
+		enabled |= (1u << channel);
+		disabled &= ~(1u << channel);
+
+		motorState[data[i].motorID] = data[i];
+	}
+
+	if ((enabled | disabled) == 0)
+	{
+		ReleaseResource(PWMR);
+		perf_end(PERF_PWM_UPDATE, start);
+		return; /* Ningún motor cambió, no se toca el SCT */
+	}
+
+	/* Se deshabilita primero el sentido opuesto de cada motor, y luego se aplican los nuevos valores.
+	   Con el SCT todos se aplican en el mismo límite de período, sin pulsos parciales. */
+	ciaaPWM_stage();
+
+	for (channel = 0; channel < PWM_CHANNEL_COUNT; channel++)
+	{
+		if (disabled & (1u << channel))
+		{
+			ciaaPWM_writeChannel(channel, duty[channel]);
+			writeStats.writes++;
 		}
-		break;
+	}
 
-	default:
-		/* Invalid motor number */
-		break;
+	for (channel = 0; channel < PWM_CHANNEL_COUNT; channel++)
+	{
+		if (enabled & (1u << channel))
+		{
+			ciaaPWM_writeChannel(channel, duty[channel]);
+			writeStats.writes++;
+		}
+	}
+
+	ciaaPWM_commit();
+
+	ReleaseResource(PWMR);
+
+	perf_end(PERF_PWM_UPDATE, start);
+}
+
+
+extern MotorControlData ciaaPWM_getMotor(uint8_t motorID)
+{
+	MotorControlData data = {motorID, 0, DIR_FORWARD};
+
+	if (motorID < PWM_MOTOR_COUNT)
+	{
+		GetResource(PWMR);
+		data.dutyCycle = ciaaPWM_dutyToPercent(motorState[motorID].duty);
+		data.direction = motorState[motorID].direction;
+		ReleaseResource(PWMR);
 	}
+
+	return data;
+}
+
+
+extern void ciaaPWM_getWriteStats(PwmWriteStats * stats)
+{
+	*stats = writeStats;
+}
+
+
+extern int32_t ciaaPWM_setFrequency(uint32_t frequencyHz)
+{
+#if BOARD_PWM_DIRECT
+	uint8_t i;
+
+	if (frequencyHz < PWM_MIN_FREQUENCY_HZ || frequencyHz > PWM_MAX_FREQUENCY_HZ)
+	{
+		return -1;
+	}
+
+	/* El tiempo muerto de cada señal debe seguir siendo a lo sumo medio período */
+	for (i = 0; i < PWM_CHANNEL_COUNT; i++)
+	{
+		if ((uint64_t)deadTimeNS[i] * 2 * frequencyHz > 1000000000u)
+		{
+			return -1;
+		}
+	}
+
+	frequency = frequencyHz;
+	configPending = 1;
+
+	return 1;
+#else
+	return -1;
+#endif
+}
+
+
+extern uint32_t ciaaPWM_getFrequency(void)
+{
+#if BOARD_PWM_DIRECT
+	return frequency;
+#else
+	return 0;
+#endif
+}
+
+
+extern uint32_t ciaaPWM_getResolution(void)
+{
+#if BOARD_PWM_DIRECT
+	return periodTicks;
+#else
+	return 100;
+#endif
+}
+
+
+extern int32_t ciaaPWM_setDeadTime(uint8_t channel, uint16_t newDeadTimeNS)
+{
+#if PWM_DEADTIME_SUPPORTED
+	if (channel >= PWM_CHANNEL_COUNT || (uint64_t)newDeadTimeNS * 2 * frequency > 1000000000u)
+	{
+		return -1;
+	}
+
+	deadTimeNS[channel] = newDeadTimeNS;
+	configPending = 1;
+
+	return 1;
+#else
+	return -1;
+#endif
+}
+
+
+extern uint16_t ciaaPWM_getDeadTime(uint8_t channel)
+{
+#if BOARD_PWM_DIRECT
+	return (channel < PWM_CHANNEL_COUNT ? deadTimeNS[channel] : 0);
+#else
+	return 0;
+#endif
+}
+
+
+extern void ciaaPWM_applyConfig(void)
+{
+#if BOARD_PWM_DIRECT
+	uint16_t duty[PWM_CHANNEL_COUNT];
+	uint8_t i;
+
+	if (!configPending)
+	{
+		return;
+	}
+	configPending = 0;
+
+	GetResource(PWMR);
+
+	/* Detiene el SCT y pone su contador en 0 */
+	Chip_SCTPWM_SetRate(LPC_SCT, frequency);
+	periodTicks = Chip_SCTPWM_GetTicksPerCycle(LPC_SCT);
+
+	for (i = 0; i < PWM_CHANNEL_COUNT; i++)
+	{
+		deadTicks[i] = ciaaPWM_deadTimeTicks(deadTimeNS[i]);
+#if PWM_DEADTIME_SUPPORTED
+		Chip_SCTPWM_SetDutyCycle(LPC_SCT, PWM_SCT_DEADTIME_MATCH(i), deadTicks[i]);
+#endif
+		duty[i] = 0;
+	}
+
+	/* Los ciclos de trabajo son relativos al período, se vuelven a escribir con el nuevo */
+	for (i = 0; i < PWM_MOTOR_COUNT; i++)
+	{
+		duty[motorChannels[i][motorState[i].direction]] = motorState[i].duty;
+	}
+
+	for (i = 0; i < PWM_CHANNEL_COUNT; i++)
+	{
+		ciaaPWM_writeChannel(i, duty[i]);
+	}
+
+	/* Con el contador en 0 el primer evento es el límite, que recarga todos los match */
+	Chip_SCTPWM_Start(LPC_SCT);
+
+	ReleaseResource(PWMR);
+#endif
 }
 
+/*==================[end of file]============================================*/
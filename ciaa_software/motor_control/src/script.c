@@ -0,0 +1,263 @@
+/*==================[inclusions]=============================================*/
+
+#include "script.h"
+#include "main.h"
+#include "encoder.h"
+#include "speed_control.h"
+
+/*==================[macros and definitions]=================================*/
+
+/** \brief Lectura de argumentos little-endian del guion. */
+#define SCRIPT_U16(ptr)		((uint16_t)((ptr)[0] | ((uint16_t)(ptr)[1] << 8)))
+#define SCRIPT_U32(ptr)		((uint32_t)SCRIPT_U16(ptr) | ((uint32_t)SCRIPT_U16(&(ptr)[2]) << 16))
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+/** \brief Verifica el guion cargado, \return Si es negativo, era inválido. */
+static int32_t script_validate(void);
+
+/** \brief Pone el ciclo de trabajo de todos los motores en 0. */
+static void script_stopMotors(void);
+
+/*==================[internal data definition]===============================*/
+
+/** \brief Longitud de cada instrucción, con su código, indexada por \p ScriptOpcode. */
+static const uint8_t opLength[SCRIPT_OP_COUNT] = {1, 3, 4, 6, 3, 8, 1};
+
+static uint8_t program[SCRIPT_MAX_LENGTH];
+static uint16_t programLength = 0;
+
+static volatile uint8_t state = SCRIPT_STATE_IDLE;
+static uint16_t pc;
+static uint32_t samples;
+
+/** \brief Instrucción ESPERAR o DISTANCIA en curso. */
+static uint8_t waiting;
+static int32_t waitLeftMS;
+static uint8_t timeoutEnabled;
+static int32_t distanceStart;
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+static int32_t script_validate(void)
+{
+	const uint8_t * ins;
+	uint16_t i = 0;
+
+	while (i < programLength)
+	{
+		ins = &program[i];
+
+		if (ins[0] >= SCRIPT_OP_COUNT || i + opLength[ins[0]] > programLength)
+		{
+			return -1;
+		}
+
+		switch (ins[0])
+		{
+		case SCRIPT_OP_END:
+			return 1;
+		case SCRIPT_OP_DUTY:
+			if (ins[1] >= MOTOR_COUNT || (int8_t)ins[2] < -100 || (int8_t)ins[2] > 100)
+			{
+				return -1;
+			}
+			break;
+		case SCRIPT_OP_SPEED:
+		case SCRIPT_OP_RAMP:
+			if (ins[1] >= MOTOR_COUNT)
+			{
+				return -1;
+			}
+			break;
+		case SCRIPT_OP_DISTANCE:
+			if (ins[1] >= ENCODER_COUNT)
+			{
+				return -1;
+			}
+			break;
+		default:
+			break;
+		}
+
+		i += opLength[ins[0]];
+	}
+
+	return -1; /* Sin FIN */
+}
+
+
+static void script_stopMotors(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < MOTOR_COUNT; i++)
+	{
+		speedControl_setDutyCycle(i, 0);
+	}
+}
+
+/*==================[external functions definition]==========================*/
+
+extern int32_t script_load(uint16_t offset, const uint8_t * data, uint16_t length)
+{
+	uint16_t i;
+
+	if (state == SCRIPT_STATE_RUNNING || (uint32_t)offset + length > SCRIPT_MAX_LENGTH)
+	{
+		return -1;
+	}
+
+	if (offset == 0)
+	{
+		programLength = 0;
+	}
+
+	for (i = 0; i < length; i++)
+	{
+		program[offset + i] = data[i];
+	}
+
+	if (offset + length > programLength)
+	{
+		programLength = offset + length;
+	}
+
+	state = SCRIPT_STATE_IDLE;
+
+	return 1;
+}
+
+
+extern int32_t script_start(void)
+{
+	if (state == SCRIPT_STATE_RUNNING || script_validate() < 0)
+	{
+		return -1;
+	}
+
+	pc = 0;
+	samples = 0;
+	waiting = 0;
+
+	/* EncoderTask lo ve recién cuando todo lo anterior está listo */
+	COMPILER_BARRIER();
+	state = SCRIPT_STATE_RUNNING;
+
+	return 1;
+}
+
+
+extern void script_abort(void)
+{
+	if (state == SCRIPT_STATE_RUNNING)
+	{
+		state = SCRIPT_STATE_ABORTED;
+	}
+}
+
+
+extern void script_update(void)
+{
+	const uint8_t * ins;
+	uint32_t moved;
+	uint8_t steps;
+
+	if (state != SCRIPT_STATE_RUNNING)
+	{
+		return;
+	}
+	COMPILER_BARRIER();
+
+	samples++;
+
+	if (waiting)
+	{
+		ins = &program[pc];
+
+		if (ins[0] == SCRIPT_OP_WAIT)
+		{
+			waitLeftMS -= encoder_getSamplePeriod();
+			if (waitLeftMS > 0)
+			{
+				return;
+			}
+		}
+		else /* SCRIPT_OP_DISTANCE */
+		{
+			moved = (uint32_t)(encoder_getSamplePosition(ins[1]) - distanceStart);
+			moved = ((int32_t)moved < 0 ? -moved : moved);
+
+			if (moved < SCRIPT_U32(&ins[2]))
+			{
+				waitLeftMS -= encoder_getSamplePeriod();
+				if (timeoutEnabled && waitLeftMS <= 0)
+				{
+					script_stopMotors();
+					state = SCRIPT_STATE_ERROR;
+				}
+				return;
+			}
+		}
+
+		waiting = 0;
+		pc += opLength[ins[0]];
+	}
+
+	for (steps = 0; steps < SCRIPT_MAX_STEPS; steps++)
+	{
+		ins = &program[pc];
+
+		switch (ins[0])
+		{
+		case SCRIPT_OP_END:
+			state = SCRIPT_STATE_DONE;
+			return;
+		case SCRIPT_OP_DUTY:
+			speedControl_setDutyCycle(ins[1], (int8_t)ins[2]);
+			break;
+		case SCRIPT_OP_SPEED:
+			speedControl_setSetpoint(ins[1], (int16_t)SCRIPT_U16(&ins[2]));
+			break;
+		case SCRIPT_OP_RAMP:
+			speedControl_setLimits(ins[1], SCRIPT_U16(&ins[2]), SCRIPT_U16(&ins[4]));
+			break;
+		case SCRIPT_OP_WAIT:
+			waitLeftMS = SCRIPT_U16(&ins[1]);
+			if (waitLeftMS > 0)
+			{
+				waiting = 1;
+				return;
+			}
+			break;
+		case SCRIPT_OP_DISTANCE:
+			distanceStart = encoder_getSamplePosition(ins[1]);
+			waitLeftMS = SCRIPT_U16(&ins[6]);
+			timeoutEnabled = (waitLeftMS > 0);
+			waiting = 1;
+			return;
+		case SCRIPT_OP_STOP:
+			script_stopMotors();
+			break;
+		default:
+			break;
+		}
+
+		pc += opLength[ins[0]];
+	}
+}
+
+
+extern void script_getStatus(ScriptStatus * status)
+{
+	status->state = state;
+	status->pc = pc;
+	status->length = programLength;
+	status->samples = samples;
+}
+
+/*==================[end of file]============================================*/
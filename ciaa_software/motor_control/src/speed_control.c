@@ -0,0 +1,573 @@
+/*==================[inclusions]=============================================*/
+
+#include "speed_control.h"
+#include "main.h"
+#include "encoder.h"
+#include "pwm.h"
+#include "perf.h"
+#include "trajectory.h"
+
+/*==================[macros and definitions]=================================*/
+
+/** \brief Bits fraccionarios de las ganancias internas y de la salida. */
+#define GAIN_Q_BITS			(24)
+#define OUTPUT_Q_BITS		(16)
+
+/** \brief Salida máxima, 100 % en Q16. */
+#define OUTPUT_MAX			(100L << OUTPUT_Q_BITS)
+
+/*==================[internal data declaration]==============================*/
+
+/** \brief Qué consigna sigue cada motor. */
+typedef enum {
+	CONTROL_OFF = 0,	/* Sin control, la salida PWM queda con el último valor */
+	CONTROL_DUTY,		/* Ciclo de trabajo a lazo abierto, en % */
+	CONTROL_SPEED		/* Velocidad a lazo cerrado, en décimas de RPM */
+} controlMode;
+
+typedef struct {
+	uint8_t		mode; /* controlMode */
+	volatile uint8_t	pending; /* Hay una nueva consigna, escrita fuera de EncoderTask */
+	uint8_t		pendingMode;
+	int32_t		pendingTarget; /* En las unidades de pendingMode */
+	uint32_t	accel, jerk; /* Límites de la trayectoria, en % o RPM por segundo (y por segundo al cuadrado) */
+	Trajectory	ramp; /* Trayectoria de la consigna, en las unidades del modo */
+	int32_t		setpoint; /* Décimas de RPM, el valor actual de la trayectoria */
+	uint16_t	kp, ki, kd; /* Milésimas, tal como se configuraron */
+	int64_t		kpQ, kiQ, kdQ; /* Q24 % por décima de RPM, por ejecución */
+	int32_t		integral; /* Q16 % */
+	int32_t		lastSpeed; /* Décimas de RPM */
+	uint8_t		ffValid; /* Si la tabla de prealimentación tiene una caracterización completa */
+	uint16_t	ffTable[SPEED_CONTROL_FF_POINTS]; /* Décimas de RPM, no decreciente */
+} controllerData;
+
+/*==================[internal functions declaration]=========================*/
+
+static void speedControl_computeGains(controllerData * c);
+static uint16_t speedControl_period(void);
+static int32_t speedControl_feedForward(const controllerData * c);
+
+/** \brief Deja una consigna para que EncoderTask la tome en su próxima ejecución. */
+static void speedControl_setPending(uint8_t motorID, int32_t target, uint8_t mode);
+
+/*==================[internal data definition]===============================*/
+
+static controllerData controller[MOTOR_COUNT];
+
+/** \brief Cada cuántas muestras se ejecuta el control, y las que faltan para la próxima ejecución. */
+static uint16_t divider = 1;
+static uint16_t samplesLeft = 1;
+
+/** \brief Período de ejecución con el que se calcularon las ganancias internas. */
+static uint16_t periodMS = 0;
+
+/** \brief Medición del período real de ejecución. */
+static uint32_t lastRunTime;
+static uint8_t lastRunValid;
+static uint32_t timingCount;
+static uint64_t jitterSum;
+static uint32_t jitterMax;
+
+/** \brief Consignas de varios motores a medio escribir; EncoderTask no las toma hasta que estén todas. */
+static volatile uint8_t batchPending = 0;
+
+/** \brief Caracterización en curso: motor, puntos registrados y sus velocidades. */
+static uint8_t pendingMotor;
+static uint8_t pendingPoints;
+static uint16_t pendingTable[SPEED_CONTROL_FF_POINTS];
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+/** \brief Convierte las ganancias configuradas a las internas, para el período actual. */
+static void speedControl_computeGains(controllerData * c)
+{
+	/* Milésimas de % por RPM equivalen a Q24 / 10000 por décima de RPM */
+	c->kpQ = ((int64_t)c->kp << GAIN_Q_BITS) / 10000;
+	c->kiQ = (((int64_t)c->ki << GAIN_Q_BITS) * periodMS) / 10000000;
+	c->kdQ = (((int64_t)c->kd << GAIN_Q_BITS) * 1000) / (10000 * (int64_t)periodMS);
+}
+
+/** \brief Período de ejecución en ms, saturado: el de muestreo puede cambiar después de fijar el divisor. */
+static uint16_t speedControl_period(void)
+{
+	uint32_t period = (uint32_t)divider * encoder_getSamplePeriod();
+
+	return (uint16_t)(period > SPEED_CONTROL_MAX_PERIOD_MS ? SPEED_CONTROL_MAX_PERIOD_MS : period);
+}
+
+/** \brief Ciclo de trabajo de prealimentación para la consigna, en Q16 % con su signo.
+ *
+ * Busca en la tabla el tramo que contiene la velocidad deseada e interpola el ciclo de
+ * trabajo. En una zona muerta (velocidades iguales) se toma su último punto, por lo que
+ * velocidades bajas parten del ciclo de trabajo mínimo para vencer el rozamiento.
+ */
+static int32_t speedControl_feedForward(const controllerData * c)
+{
+	const uint16_t * t = c->ffTable;
+	uint32_t speed = (c->setpoint < 0 ? -c->setpoint : c->setpoint);
+	int32_t duty;
+	uint8_t low = 0;
+	uint8_t high = SPEED_CONTROL_FF_POINTS - 1;
+	uint8_t mid;
+
+	if (!c->ffValid)
+	{
+		return 0;
+	}
+
+	if (speed >= t[high])
+	{
+		duty = OUTPUT_MAX;
+	}
+	else if (speed < t[0])
+	{
+		/* Velocidad medida con ciclo de trabajo 0 distinta de cero (el motor seguía girando,
+		   o un flanco espurio): por debajo de ella no hay prealimentación */
+		duty = 0;
+	}
+	else
+	{
+		/* Último punto con velocidad <= a la deseada: t[low] <= speed < t[high] */
+		while (high - low > 1)
+		{
+			mid = (low + high) / 2;
+			if (t[mid] <= speed)
+			{
+				low = mid;
+			}
+			else
+			{
+				high = mid;
+			}
+		}
+
+		duty = ((int32_t)low * SPEED_CONTROL_FF_STEP << OUTPUT_Q_BITS);
+
+		/* La tabla se fuerza no decreciente, puede tener mesetas */
+		if (t[high] > t[low])
+		{
+			duty += (int32_t)(((uint64_t)SPEED_CONTROL_FF_STEP << OUTPUT_Q_BITS) * (speed - t[low]) / (t[high] - t[low]));
+		}
+	}
+
+	return (c->setpoint < 0 ? -duty : duty);
+}
+
+static void speedControl_setPending(uint8_t motorID, int32_t target, uint8_t mode)
+{
+	/* pending se escribe al final */
+	controller[motorID].pendingTarget = target;
+	controller[motorID].pendingMode = mode;
+	COMPILER_BARRIER();
+	controller[motorID].pending = 1;
+}
+
+/*==================[external functions definition]==========================*/
+
+extern void speedControl_init(void)
+{
+	uint8_t i;
+
+	periodMS = speedControl_period();
+
+	for (i = 0; i < MOTOR_COUNT; i++)
+	{
+		controller[i].mode = CONTROL_OFF;
+		controller[i].pending = 0;
+		controller[i].kp = SPEED_CONTROL_DEFAULT_KP;
+		controller[i].ki = SPEED_CONTROL_DEFAULT_KI;
+		controller[i].kd = SPEED_CONTROL_DEFAULT_KD;
+		speedControl_computeGains(&controller[i]);
+	}
+}
+
+
+extern void speedControl_update(void)
+{
+	MotorPwmData output[MOTOR_COUNT];
+	uint32_t duty;
+	controllerData * c;
+	uint32_t start = perf_begin();
+	uint32_t nominal;
+	uint32_t jitter;
+	int32_t speed;
+	int32_t error;
+	int32_t integral;
+	int64_t u;
+	int32_t reference;
+	MotorControlData applied;
+	uint32_t stepStart;
+	uint8_t count = 0;
+	uint8_t i;
+
+	if (--samplesLeft > 0)
+	{
+		return;
+	}
+	samplesLeft = divider;
+
+	/* Si cambió el período de muestreo, cambia el de ejecución */
+	if (periodMS != speedControl_period())
+	{
+		periodMS = speedControl_period();
+		for (i = 0; i < MOTOR_COUNT; i++)
+		{
+			speedControl_computeGains(&controller[i]);
+		}
+		lastRunValid = 0;
+	}
+
+	/* Jitter: diferencia absoluta entre el período real y el nominal */
+	if (lastRunValid)
+	{
+		nominal = (uint32_t)periodMS * 1000 * timestamp_cyclesPerMicrosecond();
+		jitter = start - lastRunTime;
+		jitter = (jitter > nominal ? jitter - nominal : nominal - jitter);
+		timingCount++;
+		jitterSum += jitter;
+		if (jitter > jitterMax)
+		{
+			jitterMax = jitter;
+		}
+	}
+	lastRunTime = start;
+	lastRunValid = 1;
+
+	for (i = 0; i < MOTOR_COUNT; i++)
+	{
+		c = &controller[i];
+		speed = encoder_getSpeed(i, SPEED_TYPE_OBSERVED);
+
+		/* Nueva consigna: al cambiar de modo la trayectoria parte del estado actual del motor */
+		if (c->pending && !batchPending)
+		{
+			/* La consigna se lee después de ver pending */
+			COMPILER_BARRIER();
+
+			if (c->pendingMode != c->mode)
+			{
+				if (c->pendingMode == CONTROL_DUTY)
+				{
+					applied = ciaaPWM_getMotor(i);
+					trajectory_reset(&c->ramp, (applied.direction == DIR_FORWARD ? applied.dutyCycle : -(int32_t)applied.dutyCycle));
+				}
+				else
+				{
+					trajectory_reset(&c->ramp, speed);
+					c->integral = 0;
+				}
+				c->mode = c->pendingMode;
+			}
+			trajectory_setTarget(&c->ramp, c->pendingTarget);
+			c->pending = 0;
+		}
+
+		if (c->mode == CONTROL_OFF)
+		{
+			c->lastSpeed = speed;
+			continue;
+		}
+
+		stepStart = perf_begin();
+		trajectory_setLimits(&c->ramp, (c->mode == CONTROL_SPEED ? c->accel * 10 : c->accel), (c->mode == CONTROL_SPEED ? c->jerk * 10 : c->jerk));
+		reference = trajectory_step(&c->ramp, periodMS);
+		perf_end(PERF_TRAJECTORY, stepStart);
+
+		if (c->mode == CONTROL_DUTY)
+		{
+			u = (int64_t)reference << OUTPUT_Q_BITS;
+			u = (u > OUTPUT_MAX ? OUTPUT_MAX : (u < -OUTPUT_MAX ? -OUTPUT_MAX : u));
+		}
+		else if (reference == 0)
+		{
+			c->setpoint = 0;
+			c->integral = 0;
+			u = 0;
+		}
+		else
+		{
+			c->setpoint = reference;
+			error = c->setpoint - speed;
+
+			integral = c->integral + (int32_t)((c->kiQ * error) >> (GAIN_Q_BITS - OUTPUT_Q_BITS));
+			integral = (integral > OUTPUT_MAX ? OUTPUT_MAX : (integral < -OUTPUT_MAX ? -OUTPUT_MAX : integral));
+
+			u = speedControl_feedForward(c) +
+				((c->kpQ * error) >> (GAIN_Q_BITS - OUTPUT_Q_BITS)) + integral -
+				((c->kdQ * (speed - c->lastSpeed)) >> (GAIN_Q_BITS - OUTPUT_Q_BITS));
+
+			/* Anti-windup: el integrador sólo avanza si no empuja más allá de la saturación */
+			if (!((u > OUTPUT_MAX && error > 0) || (u < -OUTPUT_MAX && error < 0)))
+			{
+				c->integral = integral;
+			}
+
+			u = (u > OUTPUT_MAX ? OUTPUT_MAX : (u < -OUTPUT_MAX ? -OUTPUT_MAX : u));
+		}
+		c->lastSpeed = speed;
+
+		output[count].motorID = i;
+		output[count].direction = (u < 0 ? DIR_BACKWARD : DIR_FORWARD);
+		/* Q16 % a 16 bits sin redondear a %: Q16 / 100 es la fracción de 1 en Q16 */
+		duty = ((uint32_t)(u < 0 ? -u : u) + 50) / 100;
+		output[count].duty = (uint16_t)(duty > PWM_DUTY_MAX ? PWM_DUTY_MAX : duty);
+		count++;
+	}
+
+	if (count > 0)
+	{
+		ciaaPWM_writeMotors(output, count);
+
+		for (i = 0; i < count; i++)
+		{
+			encoder_setDirectionHint(output[i].motorID, (output[i].direction == DIR_FORWARD ? 1 : -1));
+		}
+	}
+
+	perf_end(PERF_SPEED_CONTROL, start);
+}
+
+
+extern int32_t speedControl_setSetpoint(uint8_t motorID, int32_t rpm)
+{
+	if (motorID >= MOTOR_COUNT || rpm < -SPEED_CONTROL_MAX_RPM || rpm > SPEED_CONTROL_MAX_RPM)
+	{
+		return -1;
+	}
+
+	speedControl_setPending(motorID, rpm * 10, CONTROL_SPEED);
+
+	return 1;
+}
+
+
+extern int32_t speedControl_setSetpoints(const uint8_t * motorIDs, const int32_t * speeds, uint8_t count)
+{
+	uint8_t i;
+
+	for (i = 0; i < count; i++)
+	{
+		if (motorIDs[i] >= MOTOR_COUNT)
+		{
+			return -1;
+		}
+	}
+
+	batchPending = 1;
+	for (i = 0; i < count; i++)
+	{
+		speedControl_setPending(motorIDs[i], speeds[i], CONTROL_SPEED);
+	}
+	COMPILER_BARRIER();
+	batchPending = 0;
+
+	return 1;
+}
+
+
+extern int32_t speedControl_setDutyCycle(uint8_t motorID, int8_t dutyCycle)
+{
+	if (motorID >= MOTOR_COUNT || dutyCycle < -100 || dutyCycle > 100)
+	{
+		return -1;
+	}
+
+	speedControl_setPending(motorID, dutyCycle, CONTROL_DUTY);
+
+	return 1;
+}
+
+
+extern int32_t speedControl_setDutyCycles(const uint8_t * motorIDs, const int8_t * dutyCycles, uint8_t count)
+{
+	uint8_t i;
+
+	for (i = 0; i < count; i++)
+	{
+		if (motorIDs[i] >= MOTOR_COUNT || dutyCycles[i] < -100 || dutyCycles[i] > 100)
+		{
+			return -1;
+		}
+	}
+
+	batchPending = 1;
+	for (i = 0; i < count; i++)
+	{
+		speedControl_setPending(motorIDs[i], dutyCycles[i], CONTROL_DUTY);
+	}
+	COMPILER_BARRIER();
+	batchPending = 0;
+
+	return 1;
+}
+
+
+extern int32_t speedControl_setLimits(uint8_t motorID, uint16_t accel, uint16_t jerk)
+{
+	if (motorID >= MOTOR_COUNT)
+	{
+		return -1;
+	}
+
+	controller[motorID].accel = accel;
+	controller[motorID].jerk = jerk;
+
+	return 1;
+}
+
+
+extern uint8_t speedControl_hasLimits(uint8_t motorID)
+{
+	return (motorID < MOTOR_COUNT && controller[motorID].accel != 0);
+}
+
+
+extern void speedControl_disable(uint8_t motorID)
+{
+	if (motorID < MOTOR_COUNT)
+	{
+		controller[motorID].pending = 0;
+		controller[motorID].mode = CONTROL_OFF;
+	}
+}
+
+
+extern void speedControl_disableAll(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < MOTOR_COUNT; i++)
+	{
+		controller[i].pending = 0;
+		controller[i].mode = CONTROL_OFF;
+	}
+}
+
+
+extern int32_t speedControl_setGains(uint8_t motorID, uint16_t kp, uint16_t ki, uint16_t kd)
+{
+	controllerData * c;
+
+	if (motorID >= MOTOR_COUNT)
+	{
+		return -1;
+	}
+
+	c = &controller[motorID];
+	c->kp = kp;
+	c->ki = ki;
+	c->kd = kd;
+	speedControl_computeGains(c);
+
+	return 1;
+}
+
+
+extern int32_t speedControl_setDivider(uint16_t samples)
+{
+	if (samples == 0 || (uint32_t)samples * encoder_getSamplePeriod() > SPEED_CONTROL_MAX_PERIOD_MS)
+	{
+		return -1;
+	}
+
+	divider = samples;
+	samplesLeft = samples;
+
+	lastRunValid = 0;
+	timingCount = 0;
+	jitterSum = 0;
+	jitterMax = 0;
+
+	return 1;
+}
+
+
+extern void speedControl_getTiming(SpeedControlTiming * timing)
+{
+	timing->periodMS = periodMS;
+	timing->count = timingCount;
+	timing->averageJitterUS = (timingCount > 0 ? timestamp_toMicroseconds((uint32_t)(jitterSum / timingCount)) : 0);
+	timing->maxJitterUS = timestamp_toMicroseconds(jitterMax);
+}
+
+
+extern void speedControl_recordCharacterization(uint8_t motorID, uint8_t dutyCycle, int32_t speed)
+{
+	uint8_t point;
+	uint8_t i;
+
+	if (motorID >= MOTOR_COUNT || (dutyCycle % SPEED_CONTROL_FF_STEP) != 0)
+	{
+		return;
+	}
+
+	point = dutyCycle / SPEED_CONTROL_FF_STEP;
+
+	if (point == 0)
+	{
+		pendingMotor = motorID;
+		pendingPoints = 0;
+	}
+	else if (motorID != pendingMotor || point != pendingPoints)
+	{
+		/* Barrido de otro motor o incompleto: se descarta hasta que comience uno nuevo */
+		pendingPoints = SPEED_CONTROL_FF_POINTS + 1;
+		return;
+	}
+
+	speed = (speed < 0 ? -speed : speed);
+	speed = (speed > 0xFFFF ? 0xFFFF : speed);
+
+	/* La tabla debe ser no decreciente para poder usarla en forma inversa */
+	pendingTable[point] = (point > 0 && speed < pendingTable[point - 1] ? pendingTable[point - 1] : (uint16_t)speed);
+	pendingPoints++;
+
+	if (pendingPoints == SPEED_CONTROL_FF_POINTS)
+	{
+		/* Sólo una caracterización completa, y que llegó a moverse, reemplaza a la tabla */
+		if (pendingTable[SPEED_CONTROL_FF_POINTS - 1] > 0)
+		{
+			controller[motorID].ffValid = 0;
+			for (i = 0; i < SPEED_CONTROL_FF_POINTS; i++)
+			{
+				controller[motorID].ffTable[i] = pendingTable[i];
+			}
+			controller[motorID].ffValid = 1;
+		}
+	}
+}
+
+
+extern uint8_t speedControl_getFeedForward(uint8_t motorID, uint16_t * table)
+{
+	uint8_t i;
+
+	if (motorID >= MOTOR_COUNT || !controller[motorID].ffValid)
+	{
+		return 0;
+	}
+
+	for (i = 0; i < SPEED_CONTROL_FF_POINTS; i++)
+	{
+		table[i] = controller[motorID].ffTable[i];
+	}
+
+	return SPEED_CONTROL_FF_POINTS;
+}
+
+
+extern int32_t speedControl_clearFeedForward(uint8_t motorID)
+{
+	if (motorID >= MOTOR_COUNT)
+	{
+		return -1;
+	}
+
+	controller[motorID].ffValid = 0;
+
+	return 1;
+}
+
+/*==================[end of file]============================================*/
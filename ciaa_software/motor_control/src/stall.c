@@ -0,0 +1,159 @@
+/*==================[inclusions]=============================================*/
+
+#include "stall.h"
+#include "board.h"
+#include "main.h"
+#include "encoder.h"
+#include "pwm.h"
+#include "script.h"
+#include "speed_control.h"
+
+/*==================[macros and definitions]=================================*/
+
+/*==================[internal data declaration]==============================*/
+
+/** \brief Configuración y estado de la detección de un motor. */
+typedef struct {
+	uint8_t		minDuty; /**< En %. */
+	uint16_t	windowMS; /**< 0 deshabilitada. */
+	uint32_t	events; /**< Veces que se cortó. */
+	int32_t		startPosition; /**< Posición del encoder al comenzar la ventana. */
+	uint32_t	stalledMS; /**< Tiempo transcurrido en la ventana. */
+} stallData;
+
+/*==================[internal functions declaration]=========================*/
+
+/** \brief Corta la salida de un motor atascado. */
+static void stall_cutMotor(uint8_t motorID);
+
+/*==================[internal data definition]===============================*/
+
+static stallData motors[MOTOR_COUNT];
+
+static volatile uint8_t suspended = 0;
+
+/** \brief Hay que reiniciar las ventanas de todos los motores en la próxima muestra. */
+static volatile uint8_t restart = 0;
+
+static stallCallback_type callback = 0;
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+static void stall_cutMotor(uint8_t motorID)
+{
+	MotorPwmData data = {motorID, 0, DIR_FORWARD};
+
+	script_abort();
+	speedControl_disable(motorID);
+	ciaaPWM_writeMotors(&data, 1);
+}
+
+/*==================[external functions definition]==========================*/
+
+extern void stall_init(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < MOTOR_COUNT; i++)
+	{
+		motors[i].minDuty = STALL_DEFAULT_MIN_DUTY;
+		motors[i].windowMS = BOARD_STALL_WINDOW_MS;
+		motors[i].events = 0;
+	}
+
+	restart = 1;
+}
+
+
+extern int32_t stall_configure(uint8_t motorID, uint8_t minDuty, uint16_t windowMS)
+{
+	if (motorID >= MOTOR_COUNT || minDuty == 0 || minDuty > 100)
+	{
+		return -1;
+	}
+
+	motors[motorID].minDuty = minDuty;
+	motors[motorID].windowMS = windowMS;
+	restart = 1;
+
+	return 1;
+}
+
+
+extern int32_t stall_getConfig(uint8_t motorID, uint8_t * minDuty, uint16_t * windowMS)
+{
+	if (motorID >= MOTOR_COUNT)
+	{
+		return -1;
+	}
+
+	*minDuty = motors[motorID].minDuty;
+	*windowMS = motors[motorID].windowMS;
+
+	return (int32_t)motors[motorID].events;
+}
+
+
+extern void stall_suspend(uint8_t suspend)
+{
+	suspended = suspend;
+	restart = 1;
+}
+
+
+extern void stall_setCallback(stallCallback_type fcnPtr)
+{
+	callback = fcnPtr;
+}
+
+
+extern void stall_update(void)
+{
+	stallData * s;
+	MotorControlData output;
+	int32_t position;
+	int32_t moved;
+	uint8_t i;
+
+	if (suspended)
+	{
+		return;
+	}
+
+	for (i = 0; i < MOTOR_COUNT; i++)
+	{
+		s = &motors[i];
+		position = encoder_getSamplePosition(i);
+		output = ciaaPWM_getMotor(i);
+		moved = position - s->startPosition;
+
+		/* Nueva ventana: recién configurado, motor sin vigilar o encoder en movimiento */
+		if (restart || s->windowMS == 0 || output.dutyCycle < s->minDuty ||
+				moved >= STALL_MIN_EDGES || moved <= -STALL_MIN_EDGES)
+		{
+			s->startPosition = position;
+			s->stalledMS = 0;
+			continue;
+		}
+
+		s->stalledMS += encoder_getSamplePeriod();
+
+		if (s->stalledMS >= s->windowMS)
+		{
+			stall_cutMotor(i);
+			s->events++;
+			s->stalledMS = 0;
+
+			if (callback != 0)
+			{
+				callback(i);
+			}
+		}
+	}
+
+	restart = 0;
+}
+
+/*==================[end of file]============================================*/
@@ -0,0 +1,423 @@
+/*==================[inclusions]=============================================*/
+
+#include "telemetry.h"
+#include "esp8266.h"
+#include "encoder.h"
+#include "StringUtils.h"
+#include "binary_protocol.h"
+#include "perf.h"
+#include "odometry.h"
+
+/*==================[macros and definitions]=================================*/
+
+/** \brief Cantidad de streams distintos. */
+#define TELEMETRY_STREAM_COUNT		(4)
+
+/** \brief Codificaciones de los streams: texto (ASCII y SSE) y tramas binarias. */
+#define ENCODING_TEXT				(0)
+#define ENCODING_BINARY				(1)
+#define ENCODING_COUNT				(2)
+
+/** \brief Codificación que usa cada formato. */
+#define formatEncoding(format)		((format) == TELEMETRY_FORMAT_BINARY ? ENCODING_BINARY : ENCODING_TEXT)
+
+/** \brief Longitud máxima del stream de velocidades: un "$SPEEDXTVALOR$" por encoder, con VALOR de hasta 10 dígitos. */
+#define SPEED_SECTION_LENGTH		(ENCODER_COUNT * 19)
+
+/** \brief Longitud de la trama binaria de velocidades: tipo de dato y un u16 por encoder. */
+#define SPEED_FRAME_LENGTH			(1 + ENCODER_COUNT * 2 + BINPROTO_OVERHEAD)
+
+/** \brief Rango de los valores i16 de las tramas binarias. */
+#define I16_MAX						(32767)
+#define I16_MIN						(-32768)
+#define U16_MAX						(65535)
+
+/** \brief Longitud máxima de los streams de velocidades con signo: "$SPEEDXT" con signo y 10 dígitos. */
+#define EDGE_SPEED_SECTION_LENGTH	(ENCODER_COUNT * 20)
+
+/** \brief Longitud máxima del stream de pose: "$POSE=" y tres valores, x e y con signo. */
+#define POSE_SECTION_LENGTH			(6 + 11 + 1 + 11 + 1 + 5 + 1)
+
+/** \brief Longitud de la trama binaria de pose: x (i32), y (i32) y orientación (u16). */
+#define POSE_FRAME_LENGTH			(10 + BINPROTO_OVERHEAD)
+
+/** \brief Máxima cantidad de fragmentos por envío: encabezado SSE, streams y terminador SSE. */
+#define MAX_FRAME_PARTS				(TELEMETRY_STREAM_COUNT + 2)
+
+/*==================[internal data declaration]==============================*/
+
+typedef struct {
+	uint8_t			streams; /* 0 si la conexión no está suscripta */
+	uint8_t			rate;
+	uint8_t			countdown;
+	TelemetryFormat	format;
+	uint32_t		dropped;
+} Subscription;
+
+/** \brief Tipo de función que formatea un stream, retornando la cantidad de caracteres escritos. */
+typedef uint16_t (*streamFormatter_type)(char * buf);
+
+/*==================[internal functions declaration]=========================*/
+
+static uint16_t formatSpeed(char * buf);
+static uint16_t formatSpeedBinary(char * buf);
+static uint16_t formatSignedSpeed(char * buf, SpeedType type);
+static uint16_t formatSignedSpeedBinary(char * buf, SpeedType type);
+static uint16_t formatEdgeSpeed(char * buf);
+static uint16_t formatEdgeSpeedBinary(char * buf);
+static uint16_t formatObservedSpeed(char * buf);
+static uint16_t formatObservedSpeedBinary(char * buf);
+static uint16_t formatPose(char * buf);
+static uint16_t formatPoseBinary(char * buf);
+static int32_t sendFrame(uint8_t connectionID, uint8_t streams, TelemetryFormat format);
+
+/*==================[internal data definition]===============================*/
+
+static Subscription subscriptions[MAX_MULTIPLE_CONNECTIONS];
+
+static char speedSection[SPEED_SECTION_LENGTH + 1];
+static char speedFrame[SPEED_FRAME_LENGTH];
+static char edgeSpeedSection[EDGE_SPEED_SECTION_LENGTH + 1];
+static char edgeSpeedFrame[SPEED_FRAME_LENGTH];
+static char observedSpeedSection[EDGE_SPEED_SECTION_LENGTH + 1];
+static char observedSpeedFrame[SPEED_FRAME_LENGTH];
+static char poseSection[POSE_SECTION_LENGTH + 1];
+static char poseFrame[POSE_FRAME_LENGTH];
+
+/** \brief Formateador de cada stream en cada codificación, en el orden de sus bits en la máscara. */
+static const streamFormatter_type streamFormatters[ENCODING_COUNT][TELEMETRY_STREAM_COUNT] = {
+		{ &formatSpeed, &formatEdgeSpeed, &formatObservedSpeed, &formatPose },
+		{ &formatSpeedBinary, &formatEdgeSpeedBinary, &formatObservedSpeedBinary, &formatPoseBinary }
+};
+
+/** \brief Buffer donde queda formateado cada stream durante el período. */
+static char * const streamBuffers[ENCODING_COUNT][TELEMETRY_STREAM_COUNT] = {
+		{ speedSection, edgeSpeedSection, observedSpeedSection, poseSection },
+		{ speedFrame, edgeSpeedFrame, observedSpeedFrame, poseFrame }
+};
+
+/** \brief Longitud de cada stream formateado en el período actual. */
+static uint16_t streamLengths[ENCODING_COUNT][TELEMETRY_STREAM_COUNT];
+
+static const AT_CIPSEND_PART ssePrefix = {"data: ", 6};
+static const AT_CIPSEND_PART sseSuffix = {"\n\n", 2};
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+static uint16_t formatSpeed(char * buf)
+{
+	unsigned char * ptr = (unsigned char *)buf;
+	uint8_t i;
+
+	for (i = 0; i < ENCODER_COUNT; i++)
+	{
+		*ptr++ = '$';
+		*ptr++ = 'S';
+		*ptr++ = 'P';
+		*ptr++ = 'E';
+		*ptr++ = 'E';
+		*ptr++ = 'D';
+		ptr = uintToString(i, 1, ptr);
+		*ptr = '0' + SPEED_TYPE_INTERRUPTS;
+		ptr = uintToString(encoder_getLastCount(i), 4, ptr + 1);
+		*ptr++ = '$';
+	}
+
+	return (uint16_t)(ptr - (unsigned char *)buf);
+}
+
+
+static uint16_t formatSpeedBinary(char * buf)
+{
+	uint8_t * payload = (uint8_t *)buf + 3;
+	uint32_t count;
+	uint8_t i;
+
+	payload[0] = SPEED_TYPE_INTERRUPTS;
+
+	for (i = 0; i < ENCODER_COUNT; i++)
+	{
+		count = encoder_getLastCount(i);
+		binproto_putU16(&payload[1 + 2 * i], (count > U16_MAX ? U16_MAX : count));
+	}
+
+	return binproto_encodeInPlace(BINPROTO_MSG_SPEED, 1 + ENCODER_COUNT * 2, (uint8_t *)buf);
+}
+
+
+/** \brief Formatea una velocidad con signo de cada encoder: "$SPEEDXT" con signo y valor. */
+static uint16_t formatSignedSpeed(char * buf, SpeedType type)
+{
+	unsigned char * ptr = (unsigned char *)buf;
+	int32_t speed;
+	uint8_t i;
+
+	for (i = 0; i < ENCODER_COUNT; i++)
+	{
+		speed = encoder_getSpeed(i, type);
+
+		*ptr++ = '$';
+		*ptr++ = 'S';
+		*ptr++ = 'P';
+		*ptr++ = 'E';
+		*ptr++ = 'E';
+		*ptr++ = 'D';
+		ptr = uintToString(i, 1, ptr);
+		*ptr++ = '0' + type;
+		if (speed < 0)
+		{
+			*ptr++ = '-';
+			speed = -speed;
+		}
+		ptr = uintToString(speed, 1, ptr);
+		*ptr++ = '$';
+	}
+
+	return (uint16_t)(ptr - (unsigned char *)buf);
+}
+
+
+static uint16_t formatSignedSpeedBinary(char * buf, SpeedType type)
+{
+	uint8_t * payload = (uint8_t *)buf + 3;
+	int32_t speed;
+	uint8_t i;
+
+	payload[0] = type;
+
+	for (i = 0; i < ENCODER_COUNT; i++)
+	{
+		/* i16 con signo, saturado */
+		speed = encoder_getSpeed(i, type);
+		speed = (speed > I16_MAX ? I16_MAX : (speed < I16_MIN ? I16_MIN : speed));
+		binproto_putU16(&payload[1 + 2 * i], (uint16_t)speed);
+	}
+
+	return binproto_encodeInPlace(BINPROTO_MSG_SPEED, 1 + ENCODER_COUNT * 2, (uint8_t *)buf);
+}
+
+
+static uint16_t formatEdgeSpeed(char * buf)
+{
+	return formatSignedSpeed(buf, SPEED_TYPE_EDGE_TIMED);
+}
+
+
+static uint16_t formatEdgeSpeedBinary(char * buf)
+{
+	return formatSignedSpeedBinary(buf, SPEED_TYPE_EDGE_TIMED);
+}
+
+
+static uint16_t formatObservedSpeed(char * buf)
+{
+	return formatSignedSpeed(buf, SPEED_TYPE_OBSERVED);
+}
+
+
+static uint16_t formatObservedSpeedBinary(char * buf)
+{
+	return formatSignedSpeedBinary(buf, SPEED_TYPE_OBSERVED);
+}
+
+
+static uint16_t formatPose(char * buf)
+{
+	unsigned char * ptr = (unsigned char *)buf;
+	OdometryPose pose;
+
+	odometry_getPose(&pose);
+
+	*ptr++ = '$';
+	*ptr++ = 'P';
+	*ptr++ = 'O';
+	*ptr++ = 'S';
+	*ptr++ = 'E';
+	*ptr++ = '=';
+	if (pose.xMM < 0)
+	{
+		*ptr++ = '-';
+	}
+	ptr = uintToString(pose.xMM < 0 ? -pose.xMM : pose.xMM, 1, ptr);
+	*ptr++ = ',';
+	if (pose.yMM < 0)
+	{
+		*ptr++ = '-';
+	}
+	ptr = uintToString(pose.yMM < 0 ? -pose.yMM : pose.yMM, 1, ptr);
+	*ptr++ = ',';
+	ptr = uintToString(pose.headingMrad, 1, ptr);
+	*ptr++ = '$';
+
+	return (uint16_t)(ptr - (unsigned char *)buf);
+}
+
+
+static uint16_t formatPoseBinary(char * buf)
+{
+	uint8_t * payload = (uint8_t *)buf + 3;
+	OdometryPose pose;
+
+	odometry_getPose(&pose);
+
+	binproto_putU32(&payload[0], (uint32_t)pose.xMM);
+	binproto_putU32(&payload[4], (uint32_t)pose.yMM);
+	binproto_putU16(&payload[8], pose.headingMrad);
+
+	return binproto_encodeInPlace(BINPROTO_MSG_POSE, 10, (uint8_t *)buf);
+}
+
+
+/** \brief Encola, para una conexión, los streams ya formateados en el período. */
+static int32_t sendFrame(uint8_t connectionID, uint8_t streams, TelemetryFormat format)
+{
+	AT_CIPSEND_PART parts[MAX_FRAME_PARTS];
+	uint8_t encoding = formatEncoding(format);
+	uint8_t count = 0;
+	uint8_t i;
+
+	if (format == TELEMETRY_FORMAT_SSE)
+	{
+		parts[count++] = ssePrefix;
+	}
+
+	for (i = 0; i < TELEMETRY_STREAM_COUNT; i++)
+	{
+		if (streams & (1 << i))
+		{
+			parts[count].content = streamBuffers[encoding][i];
+			parts[count].length = streamLengths[encoding][i];
+			count++;
+		}
+	}
+
+	if (format == TELEMETRY_FORMAT_SSE)
+	{
+		parts[count++] = sseSuffix;
+	}
+
+	return esp8266_queueSendParts(connectionID, parts, count);
+}
+
+/*==================[external functions definition]==========================*/
+
+extern void telemetry_init(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < MAX_MULTIPLE_CONNECTIONS; i++)
+	{
+		subscriptions[i].streams = 0;
+		subscriptions[i].format = TELEMETRY_FORMAT_ASCII;
+		subscriptions[i].dropped = 0;
+	}
+}
+
+
+extern int32_t telemetry_subscribe(uint8_t connectionID, uint8_t streams, uint8_t rate, TelemetryFormat format)
+{
+	if (connectionID >= MAX_MULTIPLE_CONNECTIONS || (streams & ~TELEMETRY_STREAM_ALL) != 0 || rate == 0)
+	{
+		return -1;
+	}
+
+	subscriptions[connectionID].streams = streams;
+	subscriptions[connectionID].rate = rate;
+	subscriptions[connectionID].countdown = 1; /* El primer envío se realiza en el próximo período */
+	subscriptions[connectionID].format = format;
+	subscriptions[connectionID].dropped = 0;
+
+	return 1;
+}
+
+
+extern void telemetry_unsubscribe(uint8_t connectionID)
+{
+	if (connectionID < MAX_MULTIPLE_CONNECTIONS)
+	{
+		subscriptions[connectionID].streams = 0;
+	}
+}
+
+
+extern void telemetry_setFormat(uint8_t connectionID, TelemetryFormat format)
+{
+	if (connectionID < MAX_MULTIPLE_CONNECTIONS)
+	{
+		subscriptions[connectionID].format = format;
+	}
+}
+
+
+extern void telemetry_publish(uint8_t controllerID)
+{
+	uint8_t dueConnections = 0;
+	uint8_t formatStreams[ENCODING_COUNT] = {0, 0};
+	uint8_t controllerDefault = 0;
+	uint32_t start;
+	uint8_t i, j;
+
+	/* Determino quiénes deben recibir datos en este período */
+	for (i = 0; i < MAX_MULTIPLE_CONNECTIONS; i++)
+	{
+		if (subscriptions[i].streams != 0 && --subscriptions[i].countdown == 0)
+		{
+			subscriptions[i].countdown = subscriptions[i].rate;
+			dueConnections |= (1 << i);
+			formatStreams[formatEncoding(subscriptions[i].format)] |= subscriptions[i].streams;
+		}
+	}
+
+	if (controllerID < MAX_MULTIPLE_CONNECTIONS && subscriptions[controllerID].streams == 0)
+	{
+		controllerDefault = 1;
+		formatStreams[formatEncoding(subscriptions[controllerID].format)] |= TELEMETRY_STREAM_SPEED;
+	}
+
+	/* Cada stream necesario se formatea una única vez por codificación */
+	start = perf_begin();
+	for (j = 0; j < ENCODING_COUNT; j++)
+	{
+		for (i = 0; i < TELEMETRY_STREAM_COUNT; i++)
+		{
+			if (formatStreams[j] & (1 << i))
+			{
+				streamLengths[j][i] = streamFormatters[j][i](streamBuffers[j][i]);
+			}
+		}
+	}
+
+	if (formatStreams[ENCODING_TEXT] != 0 || formatStreams[ENCODING_BINARY] != 0)
+	{
+		perf_end(PERF_TELEMETRY, start);
+	}
+
+	/* Quien controla los motores recibe sus datos siempre, y antes que el resto */
+	if (controllerDefault)
+	{
+		sendFrame(controllerID, TELEMETRY_STREAM_SPEED, subscriptions[controllerID].format);
+	}
+
+	for (i = 0; i < MAX_MULTIPLE_CONNECTIONS; i++)
+	{
+		if (dueConnections & (1 << i))
+		{
+			/* Si la conexión todavía no terminó de recibir los envíos anteriores, se descarta éste */
+			if (esp8266_getPendingSends(i) >= TELEMETRY_MAX_PENDING ||
+				sendFrame(i, subscriptions[i].streams, subscriptions[i].format) < 0)
+			{
+				subscriptions[i].dropped++;
+			}
+		}
+	}
+}
+
+
+extern uint32_t telemetry_getDroppedFrames(uint8_t connectionID)
+{
+	return (connectionID < MAX_MULTIPLE_CONNECTIONS ? subscriptions[connectionID].dropped : 0);
+}
+
+/*==================[end of file]============================================*/
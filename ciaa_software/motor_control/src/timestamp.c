@@ -0,0 +1,42 @@
+/*==================[inclusions]=============================================*/
+
+#include "timestamp.h"
+
+/*==================[macros and definitions]=================================*/
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+/*==================[internal data definition]===============================*/
+
+static uint32_t cyclesPerMicrosecond = 1;
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+/*==================[external functions definition]==========================*/
+
+extern void timestamp_init(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	cyclesPerMicrosecond = SystemCoreClock / 1000000;
+}
+
+
+extern uint32_t timestamp_cyclesPerMicrosecond(void)
+{
+	return cyclesPerMicrosecond;
+}
+
+
+extern uint32_t timestamp_toMicroseconds(uint32_t cycles)
+{
+	return cycles / cyclesPerMicrosecond;
+}
+
+/*==================[end of file]============================================*/
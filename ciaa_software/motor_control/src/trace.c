@@ -0,0 +1,173 @@
+/*==================[inclusions]=============================================*/
+
+#include "trace.h"
+#include "encoder.h"
+#include "esp8266.h"
+#include "binary_protocol.h"
+#include "StringUtils.h"
+
+/*==================[macros and definitions]=================================*/
+
+/** \brief Entradas por mensaje ASCII. */
+#define ENTRIES_PER_ASCII_MESSAGE	(16)
+
+/** \brief Entradas por trama binaria: encoder (u8) y desbordes (u32) ocupan 5 bytes de datos. */
+#define ENTRIES_PER_FRAME			((BINPROTO_MAX_PAYLOAD - 5) / 4)
+
+/** \brief Longitud máxima de un mensaje ASCII: "$TRAZA=E,DESBORDES" y una entrada de hasta 10 dígitos con su coma. */
+#define ASCII_MESSAGE_LENGTH		(7 + 1 + 11 + ENTRIES_PER_ASCII_MESSAGE * 11 + 2)
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+static void sendEntries(uint8_t encoderID);
+
+/*==================[internal data definition]===============================*/
+
+/** \brief Conexión que recibe la traza, o \p MAX_MULTIPLE_CONNECTIONS si no hay traza en curso. */
+static uint8_t trace_connectionID = MAX_MULTIPLE_CONNECTIONS;
+
+static TraceFormat trace_format;
+
+static uint8_t trace_encoderMask;
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+/** \brief Envía un mensaje con las entradas más antiguas de un encoder, si las hay. */
+static void sendEntries(uint8_t encoderID)
+{
+	uint32_t entries[ENTRIES_PER_ASCII_MESSAGE];
+	uint8_t message[ASCII_MESSAGE_LENGTH > BINPROTO_MAX_FRAME_LENGTH ? ASCII_MESSAGE_LENGTH : BINPROTO_MAX_FRAME_LENGTH];
+	unsigned char * ptr;
+	AT_CIPSEND_DATA cipsend_data;
+	uint16_t generation;
+	uint16_t count;
+	uint16_t i;
+
+	/* trace_start() puede reiniciar los buffers desde otra tarea mientras se envían */
+	generation = encoder_getTraceGeneration(encoderID);
+	count = encoder_peekTrace(encoderID, entries,
+			(trace_format == TRACE_FORMAT_BINARY ? ENTRIES_PER_FRAME : ENTRIES_PER_ASCII_MESSAGE));
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	if (trace_format == TRACE_FORMAT_BINARY)
+	{
+		/* Los datos se arman directamente en su posición dentro de la trama */
+		ptr = &message[3];
+		*ptr++ = encoderID;
+		binproto_putU32(ptr, encoder_getTraceOverflows(encoderID));
+		ptr += 4;
+		for (i = 0; i < count; i++)
+		{
+			binproto_putU32(ptr, entries[i]);
+			ptr += 4;
+		}
+
+		cipsend_data.length = binproto_encodeInPlace(BINPROTO_MSG_TRAZA, (uint8_t)(ptr - &message[3]), message);
+	}
+	else
+	{
+		ptr = message;
+		*ptr++ = '$';
+		*ptr++ = 'T';
+		*ptr++ = 'R';
+		*ptr++ = 'A';
+		*ptr++ = 'Z';
+		*ptr++ = 'A';
+		*ptr++ = '=';
+		ptr = uintToString(encoderID, 1, ptr);
+		*ptr++ = ',';
+		ptr = uintToString(encoder_getTraceOverflows(encoderID), 1, ptr);
+		for (i = 0; i < count; i++)
+		{
+			*ptr++ = ',';
+			ptr = uintToString(entries[i], 1, ptr);
+		}
+		*ptr++ = '$';
+
+		cipsend_data.length = (uint16_t)(ptr - message);
+	}
+
+	cipsend_data.connectionID = trace_connectionID;
+	cipsend_data.content = (char *)message;
+	cipsend_data.copyContentToBuffer = AT_CIPSEND_CONTENT_COPYTOBUFFER;
+
+	/* Entradas de una traza anterior: no se envían */
+	if (encoder_getTraceGeneration(encoderID) != generation)
+	{
+		return;
+	}
+
+	/* Si no hay lugar en el buffer del módulo WiFi, las entradas quedan para el próximo intento */
+	if (esp8266_queueCommand(AT_CIPSENDBUF, AT_TYPE_SET, &cipsend_data) >= 0)
+	{
+		encoder_consumeTrace(encoderID, count, generation);
+	}
+}
+
+/*==================[external functions definition]==========================*/
+
+extern int32_t trace_start(uint8_t connectionID, uint8_t encoderMask, TraceFormat format)
+{
+	if (connectionID >= MAX_MULTIPLE_CONNECTIONS || encoderMask == 0 ||
+		(encoderMask & ~((1 << ENCODER_COUNT) - 1)) != 0)
+	{
+		return -1;
+	}
+
+	/* Se deshabilita primero, para que los buffers comiencen vacíos */
+	encoder_setTraceMask(0);
+
+	trace_connectionID = connectionID;
+	trace_format = format;
+	trace_encoderMask = encoderMask;
+
+	encoder_setTraceMask(encoderMask);
+
+	return 1;
+}
+
+
+extern void trace_stop(void)
+{
+	encoder_setTraceMask(0);
+	trace_connectionID = MAX_MULTIPLE_CONNECTIONS;
+}
+
+
+extern void trace_connectionClosed(uint8_t connectionID)
+{
+	if (connectionID == trace_connectionID)
+	{
+		trace_stop();
+	}
+}
+
+
+extern void trace_doWork(void)
+{
+	uint8_t encoderID;
+
+	if (trace_connectionID >= MAX_MULTIPLE_CONNECTIONS)
+	{
+		return;
+	}
+
+	for (encoderID = 0; encoderID < ENCODER_COUNT; encoderID++)
+	{
+		if ((trace_encoderMask & (1 << encoderID)) &&
+			esp8266_getPendingSends(trace_connectionID) < TRACE_MAX_PENDING)
+		{
+			sendEntries(encoderID);
+		}
+	}
+}
+
+/*==================[end of file]============================================*/
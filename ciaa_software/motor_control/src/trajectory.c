@@ -0,0 +1,123 @@
+/*==================[inclusions]=============================================*/
+
+#include "trajectory.h"
+
+/*==================[macros and definitions]=================================*/
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+static uint32_t trajectory_sqrt(uint64_t value);
+
+/*==================[internal data definition]===============================*/
+
+/*==================[external data definition]===============================*/
+
+/*==================[internal functions definition]==========================*/
+
+/** \brief Raíz cuadrada entera, bit a bit, sin divisiones. */
+static uint32_t trajectory_sqrt(uint64_t value)
+{
+	uint64_t root = 0;
+	uint64_t bit = 1ULL << 62;
+
+	while (bit > value)
+	{
+		bit >>= 2;
+	}
+
+	while (bit != 0)
+	{
+		if (value >= root + bit)
+		{
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+		{
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return (uint32_t)root;
+}
+
+/*==================[external functions definition]==========================*/
+
+extern void trajectory_reset(Trajectory * trajectory, int32_t value)
+{
+	trajectory->value = (int64_t)value << TRAJECTORY_Q_BITS;
+	trajectory->target = trajectory->value;
+	trajectory->rate = 0;
+}
+
+
+extern void trajectory_setLimits(Trajectory * trajectory, uint32_t accel, uint32_t jerk)
+{
+	trajectory->accel = accel;
+	trajectory->jerk = jerk;
+}
+
+
+extern void trajectory_setTarget(Trajectory * trajectory, int32_t target)
+{
+	trajectory->target = (int64_t)target << TRAJECTORY_Q_BITS;
+}
+
+
+extern int32_t trajectory_step(Trajectory * trajectory, uint16_t periodMS)
+{
+	int64_t distance = trajectory->target - trajectory->value;
+	int64_t absDistance = (distance < 0 ? -distance : distance);
+	int64_t maxRate;
+	int64_t stopRate;
+	int64_t delta;
+	int64_t step;
+
+	if (trajectory->accel == 0 || distance == 0)
+	{
+		trajectory->value = trajectory->target;
+		trajectory->rate = 0;
+		return (int32_t)(trajectory->target >> TRAJECTORY_Q_BITS);
+	}
+
+	maxRate = (int64_t)trajectory->accel << TRAJECTORY_Q_BITS;
+
+	if (trajectory->jerk == 0)
+	{
+		trajectory->rate = (distance > 0 ? maxRate : -maxRate);
+	}
+	else
+	{
+		/* Pendiente desde la que se puede frenar en la distancia restante: sqrt(2 * J * d), Q8 -> Q16 */
+		stopRate = (int64_t)trajectory_sqrt(2 * (uint64_t)trajectory->jerk * (uint64_t)absDistance) << (TRAJECTORY_Q_BITS / 2);
+		/* La pendiente se acerca a la buscada a lo sumo jerk * período; se frena medio paso antes
+		   para compensar la discretización */
+		delta = (((int64_t)trajectory->jerk << TRAJECTORY_Q_BITS) * periodMS) / 1000;
+		stopRate = (stopRate > delta ? stopRate - delta / 2 : (stopRate + 1) / 2);
+		maxRate = (stopRate < maxRate ? stopRate : maxRate);
+		maxRate = (distance > 0 ? maxRate : -maxRate);
+
+		step = maxRate - trajectory->rate;
+		trajectory->rate += (step > delta ? delta : (step < -delta ? -delta : step));
+	}
+
+	step = (trajectory->rate * periodMS) / 1000;
+
+	/* Si el paso alcanza el objetivo, se detiene en él */
+	if ((distance > 0 && step >= distance) || (distance < 0 && step <= distance))
+	{
+		trajectory->value = trajectory->target;
+		trajectory->rate = 0;
+	}
+	else
+	{
+		trajectory->value += step;
+	}
+
+	return (int32_t)((trajectory->value + (1L << (TRAJECTORY_Q_BITS - 1))) >> TRAJECTORY_Q_BITS);
+}
+
+/*==================[end of file]============================================*/
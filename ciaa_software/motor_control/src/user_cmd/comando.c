@@ -0,0 +1,194 @@
+/*==================[inclusions]=============================================*/
+
+#include "comando.h"
+#include "../parser_helper.h"
+
+/*==================[macros and definitions]=================================*/
+
+/*==================[internal data declaration]==============================*/
+
+/*==================[internal functions declaration]=========================*/
+
+static void init(Parser* parserPtr);
+static ParserStatus tryMatch(Parser* parserPtr, uint8_t newChar);
+static ParserStatus tryMatch_internal(	PARSER_DATA_T * internalData,
+										PARSER_RESULTS_T * results,
+										uint8_t newChar);
+static uint8_t lookupCommand(PARSER_DATA_T * internalData, PARSER_RESULTS_T * results);
+static uint8_t storeArg(PARSER_DATA_T * internalData, PARSER_RESULTS_T * results);
+
+/*==================[internal data definition]===============================*/
+
+/*==================[external data definition]===============================*/
+
+const ParserFunctions FUNCTIONS_USER_COMANDO =
+{
+    &init,
+    &tryMatch,
+    &parser_default_deinit
+};
+
+/*==================[internal functions definition]==========================*/
+
+static void init(Parser* parserPtr)
+{
+    PARSER_DATA_T * p;
+
+    if (parserPtr->data == 0)
+        parserPtr->data = (void*) malloc(sizeof(PARSER_DATA_T));
+
+    if (parserPtr->results == 0)
+        parserPtr->results = (void*) malloc(sizeof(PARSER_RESULTS_T));
+
+    p = parserPtr->data;
+    p->state = S0;
+    p->nameLength = 0;
+    p->commands = 0;
+    p->commandCount = 0;
+
+    parserPtr->status = STATUS_INITIALIZED;
+}
+
+
+static ParserStatus tryMatch(Parser* parserPtr, uint8_t newChar){
+    parserPtr->status = tryMatch_internal(parserPtr->data, parserPtr->results, newChar);
+    if (parserPtr->status == STATUS_NOT_MATCHES)
+    {
+        parserPtr->status = tryMatch_internal(parserPtr->data, parserPtr->results, newChar);
+    }
+    return parserPtr->status;
+}
+
+
+/** \brief Busca el nombre leído en la tabla de comandos.
+ *
+ * \return 1 si el nombre pertenece a la tabla, 0 en caso contrario.
+ */
+static uint8_t lookupCommand(PARSER_DATA_T * internalData, PARSER_RESULTS_T * results)
+{
+	uint8_t i, j;
+
+	internalData->name[internalData->nameLength] = '\0';
+
+	for (i = 0; i < internalData->commandCount; i++)
+	{
+		for (j = 0; internalData->commands[i][j] == internalData->name[j] && internalData->name[j] != '\0'; j++);
+
+		if (internalData->commands[i][j] == internalData->name[j])
+		{
+			results->commandIndex = i;
+			results->argCount = 0;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+
+/** \brief Guarda el argumento que se estaba leyendo.
+ *
+ * \return 1 si el argumento es válido, 0 si no tiene dígitos.
+ */
+static uint8_t storeArg(PARSER_DATA_T * internalData, PARSER_RESULTS_T * results)
+{
+	if (!internalData->hasDigits)
+	{
+		return 0;
+	}
+
+	if (internalData->negative)
+	{
+		results->args[results->argCount] = -results->args[results->argCount];
+	}
+
+	results->argCount++;
+	internalData->negative = 0;
+	internalData->hasDigits = 0;
+
+	return 1;
+}
+
+
+static ParserStatus tryMatch_internal(PARSER_DATA_T * internalData,
+                                      PARSER_RESULTS_T * results,
+                                      uint8_t newChar)
+{
+	ParserStatus ret = STATUS_NOT_MATCHES;
+
+	switch(internalData->state){
+	case S0: /* Carácter de comienzo del mensaje */
+		if (newChar == '$' && internalData->commands != 0)
+		{
+			internalData->nameLength = 0;
+			internalData->state = S1;
+			ret = STATUS_INCOMPLETE;
+		}
+		break;
+	case S1: /* Lectura del nombre del comando, hasta '=' (con argumentos) o '$' (sin argumentos) */
+		if ((newChar >= 'A' && newChar <= 'Z') || (newChar >= '0' && newChar <= '9') || newChar == '_' || newChar == '?')
+		{
+			if (internalData->nameLength < COMANDO_MAX_NAME_LENGTH)
+			{
+				internalData->name[internalData->nameLength++] = newChar;
+				ret = STATUS_INCOMPLETE;
+			}
+		}
+		else if (newChar == '=' && lookupCommand(internalData, results))
+		{
+			internalData->negative = 0;
+			internalData->hasDigits = 0;
+			results->args[0] = 0;
+			internalData->state = S2;
+			ret = STATUS_INCOMPLETE;
+		}
+		else if (newChar == '$' && lookupCommand(internalData, results))
+		{
+			ret = STATUS_COMPLETE;
+		}
+		break;
+	case S2: /* Lectura de los argumentos, enteros decimales separados por ',' */
+		/* Un argumento que no entra en 32 bits descarta el comando, en lugar de desbordar */
+		if (newChar >= '0' && newChar <= '9' &&
+				results->args[results->argCount] <= (INT32_MAX - (newChar - '0')) / 10)
+		{
+			results->args[results->argCount] = (results->args[results->argCount] * 10) + (newChar - '0');
+			internalData->hasDigits = 1;
+			ret = STATUS_INCOMPLETE;
+		}
+		else if (newChar == '-' && !internalData->hasDigits && !internalData->negative)
+		{
+			internalData->negative = 1;
+			ret = STATUS_INCOMPLETE;
+		}
+		else if (newChar == ',' && results->argCount < (COMANDO_MAX_ARGS - 1) && storeArg(internalData, results))
+		{
+			results->args[results->argCount] = 0;
+			ret = STATUS_INCOMPLETE;
+		}
+		else if (newChar == '$' && storeArg(internalData, results))
+		{
+			ret = STATUS_COMPLETE;
+		}
+		break;
+	default:
+		break;
+	}
+
+
+	if (ret == STATUS_NOT_MATCHES || ret == STATUS_COMPLETE){
+		internalData->state = S0;
+		internalData->nameLength = 0;
+	}
+
+	return ret;
+}
+
+/*==================[external functions definition]==========================*/
+
+extern void comandoParser_setCommands(Parser* parserPtr, const char * const * commands, uint8_t count)
+{
+	((PARSER_DATA_T*)parserPtr->data)->commands = commands;
+	((PARSER_DATA_T*)parserPtr->data)->commandCount = count;
+	((PARSER_DATA_T*)parserPtr->data)->state = S0;
+}